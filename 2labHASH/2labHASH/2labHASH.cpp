@@ -4,11 +4,58 @@
 #include <cstdlib>
 #include <ctime>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <bit>
+#include <span>
+#include <array>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <climits>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <unordered_map>
+#include <unordered_set>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASH_SSE2
+#endif
+#if defined(__AVX2__) || defined(__AVX512VBMI__)
+#include <immintrin.h>
+#endif
+#ifdef __AVX2__
+#define HASH_AVX2
+#endif
+#if defined(__AVX512VBMI__) && defined(__AVX512BW__)
+#define HASH_AVX512VBMI
+#endif
 using namespace std;
 
 
-unsigned int pearson_hash(const std::string& key) {
-    static const unsigned char table[256] = {
+static const unsigned char pearson_table[256] = {
     98, 6, 85, 150, 36, 23, 112, 164, 135, 207, 169, 9, 55, 64, 90, 171,
     198, 166, 208, 128, 181, 148, 114, 194, 231, 6, 160, 117, 86, 96, 126, 110,
     138, 39, 185, 100, 97, 5, 220, 203, 18, 67, 253, 242, 64, 208, 115, 117,
@@ -25,11 +72,12 @@ unsigned int pearson_hash(const std::string& key) {
     248, 124, 87, 199, 9, 0, 19, 159, 50, 129, 142, 178, 48, 151, 250, 11,
     49, 77, 96, 53, 214, 165, 13, 168, 25, 194, 55, 113, 66, 107, 100, 125,
     80, 214, 33, 173, 191, 63, 187, 60, 182, 52, 116, 27, 8, 122, 178, 209,
-    };
+};
 
+unsigned int pearson_hash(const std::string& key) {
     unsigned int hash = 0;
     for (char c : key) {
-        hash = table[hash ^ static_cast<unsigned char>(c)]; // XOR BETWEEN VALUE OF HASH AND ASCII CODE OF C(CHAR)
+        hash = pearson_table[hash ^ static_cast<unsigned char>(c)]; // XOR BETWEEN VALUE OF HASH AND ASCII CODE OF C(CHAR)
     }
     return hash;
 }
@@ -41,42 +89,620 @@ bool compare_hashes(const std::string& str1, const std::string& str2) {
     return hash1 == hash2;
 }
 
+// hasher policies for MyUnorderedMap, all return 64 bits
+
+// murmur3 finalizer, a few multiplies and no allocation
+struct IntHash {
+    uint64_t operator()(int key) const {
+        uint64_t h = static_cast<uint32_t>(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// pearson_table is not a permutation: two states can map to the same byte and
+// then stay equal. Pearson64Hash steps through this shuffle of 0..255 instead,
+// so different lane states stay different after every byte
+static constexpr std::array<unsigned char, 256> pearson_permutation = []() {
+    std::array<unsigned char, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        table[i] = static_cast<unsigned char>(i);
+    }
+    uint64_t state = 0; // splitmix64 drives a Fisher-Yates shuffle
+    for (int i = 255; i > 0; --i) {
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        std::swap(table[i], table[z % (i + 1)]);
+    }
+    return table;
+}();
+
+// xored into every index of its lane: with one shared table the lanes would
+// otherwise be the same function and, once equal, stay equal for the rest of the key
+static constexpr unsigned char pearson64_salt[8] = { 0x00, 0x9e, 0x37, 0x79, 0xb9, 0x7f, 0x4a, 0x15 };
+
+// 8 pearson lanes over pearson_permutation give 64 bits, each lane has its own
+// start byte and salt; the lanes are independent so their table lookups overlap
+struct Pearson64Hash {
+    uint64_t operator()(const char* data, size_t length) const {
+        unsigned char h[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            for (int lane = 0; lane < 8; ++lane) {
+                h[lane] = pearson_permutation[h[lane] ^ c ^ pearson64_salt[lane]];
+            }
+        }
+        uint64_t result = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            result = (result << 8) | h[lane];
+        }
+        return result;
+    }
+
+    // std::string and string literals convert to string_view without copying
+    uint64_t operator()(std::string_view key) const {
+        return (*this)(key.data(), key.size());
+    }
+
+    // the 4 bytes of the key, not its decimal text
+    uint64_t operator()(int key) const {
+        char bytes[sizeof(int)];
+        std::memcpy(bytes, &key, sizeof(int));
+        return (*this)(bytes, sizeof(int));
+    }
+};
+
+// Pearson64Hash of many strings at once, hashes[i] == Pearson64Hash()(strings[i]).
+// The 8 lanes of a string take the same byte at every step, so a step over a
+// whole group of strings is a vector operation:
+// - AVX-512 VBMI: 8 strings x 8 lanes fill one register, pearson_permutation sits
+//   in four more and two vpermi2b plus a blend look up all 64 lanes;
+// - AVX2: per string two xors and one gather from a 32-bit copy of the table,
+//   4 strings interleaved so the gathers overlap;
+// - otherwise strings go one by one through Pearson64Hash, whose 8 lanes
+//   already overlap and keep the loads busy.
+#if defined(HASH_AVX512VBMI)
+static constexpr size_t pearson_group = 8;
+
+static void pearson64_group(const std::string_view* strings, size_t n, uint64_t* hashes) {
+    const unsigned char* table = pearson_permutation.data();
+    const __m512i t0 = _mm512_loadu_si512(table), t1 = _mm512_loadu_si512(table + 64);
+    const __m512i t2 = _mm512_loadu_si512(table + 128), t3 = _mm512_loadu_si512(table + 192);
+    // byte 8 * s + lane is lane `lane` of string s
+    __m512i h = _mm512_set1_epi64(0x0706050403020100LL);
+    uint64_t salt_bytes;
+    std::memcpy(&salt_bytes, pearson64_salt, 8);
+    const __m512i salt = _mm512_set1_epi64(static_cast<long long>(salt_bytes));
+    // spreads byte s of a 64-bit word over bytes 8 * s .. 8 * s + 7
+    const __m512i spread = _mm512_set_epi64(0x0707070707070707LL, 0x0606060606060606LL, 0x0505050505050505LL,
+        0x0404040404040404LL, 0x0303030303030303LL, 0x0202020202020202LL, 0x0101010101010101LL, 0);
+    size_t longest = 0;
+    for (size_t s = 0; s < n; ++s) {
+        longest = std::max(longest, strings[s].size());
+    }
+    for (size_t i = 0; i < longest; ++i) {
+        uint64_t bytes = 0;
+        __mmask64 active = 0;
+        for (size_t s = 0; s < n; ++s) {
+            if (i < strings[s].size()) {
+                bytes |= static_cast<uint64_t>(static_cast<unsigned char>(strings[s][i])) << (8 * s);
+                active |= 0xFFULL << (8 * s);
+            }
+        }
+        __m512i index = _mm512_xor_si512(_mm512_xor_si512(h, salt),
+            _mm512_maskz_permutexvar_epi8(active, spread, _mm512_set1_epi64(static_cast<long long>(bytes))));
+        __m512i low = _mm512_permutex2var_epi8(t0, index, t1);
+        __m512i high = _mm512_permutex2var_epi8(t2, index, t3);
+        __m512i next = _mm512_mask_blend_epi8(_mm512_movepi8_mask(index), low, high);
+        h = _mm512_mask_blend_epi8(active, h, next); // finished strings keep their lanes
+    }
+    alignas(64) unsigned char lanes[64];
+    _mm512_store_si512(lanes, h);
+    for (size_t s = 0; s < n; ++s) {
+        uint64_t result = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            result = (result << 8) | lanes[8 * s + lane];
+        }
+        hashes[s] = result;
+    }
+}
+#elif defined(HASH_AVX2)
+static constexpr size_t pearson_group = 4;
+
+static const int* pearson_table32() {
+    static const std::array<int, 256> table = []() {
+        std::array<int, 256> wide{};
+        for (int i = 0; i < 256; ++i) {
+            wide[i] = pearson_permutation[i];
+        }
+        return wide;
+    }();
+    return table.data();
+}
+
+static void pearson64_group(const std::string_view* strings, size_t n, uint64_t* hashes) {
+    const int* table = pearson_table32();
+    const __m256i salt = _mm256_setr_epi32(pearson64_salt[0], pearson64_salt[1], pearson64_salt[2], pearson64_salt[3],
+        pearson64_salt[4], pearson64_salt[5], pearson64_salt[6], pearson64_salt[7]);
+    __m256i h[pearson_group];
+    size_t common = strings[0].size();
+    for (size_t s = 0; s < n; ++s) {
+        h[s] = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        common = std::min(common, strings[s].size());
+    }
+    auto step = [&](size_t s, size_t i) {
+        __m256i c = _mm256_xor_si256(salt, _mm256_set1_epi32(static_cast<unsigned char>(strings[s][i])));
+        h[s] = _mm256_i32gather_epi32(table, _mm256_xor_si256(h[s], c), 4);
+    };
+    for (size_t i = 0; i < common; ++i) {
+        for (size_t s = 0; s < n; ++s) {
+            step(s, i);
+        }
+    }
+    for (size_t s = 0; s < n; ++s) {
+        for (size_t i = common; i < strings[s].size(); ++i) {
+            step(s, i);
+        }
+        alignas(32) int lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), h[s]);
+        uint64_t result = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            result = (result << 8) | static_cast<unsigned char>(lanes[lane]);
+        }
+        hashes[s] = result;
+    }
+}
+#else
+static constexpr size_t pearson_group = 1;
+
+static void pearson64_group(const std::string_view* strings, size_t, uint64_t* hashes) {
+    hashes[0] = Pearson64Hash()(strings[0]);
+}
+#endif
+
+void pearson64_hash_many(const std::string_view* strings, size_t count, uint64_t* hashes) {
+    for (size_t start = 0; start < count; start += pearson_group) {
+        pearson64_group(strings + start, std::min(pearson_group, count - start), hashes + start);
+    }
+}
+
+// the original scheme: decimal text through 8-bit pearson, 256 buckets at most
+struct LegacyPearsonHash {
+    uint64_t operator()(int key) const {
+        std::stringstream ss;
+        ss << key;
+        return pearson_hash(ss.str());
+    }
+};
+
+// hasher used when MyUnorderedMap is not given one
+template<typename K>
+struct DefaultHash;
+
+template<>
+struct DefaultHash<int> : IntHash {};
+
+// transparent, so a map keyed by std::string is searched by string_view or char*
+template<>
+struct DefaultHash<std::string> : Pearson64Hash {
+    using is_transparent = void;
+};
+
+// folds all 64 bits of a hash into a bucket index, not just the low ones
+inline unsigned int bucket_index(uint64_t hash, unsigned int buckets) {
+    hash = (hash ^ (hash >> 32)) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<unsigned int>((hash >> 32) % buckets);
+}
+
+inline void prefetch(const void* address) {
+#if defined(HASH_SSE2)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(address);
+#endif
+}
+
+template<typename K, typename V, typename Hash, typename Eq, typename Alloc>
+class ConcurrentUnorderedMap;
+
+template<typename K, typename V, typename Hash, typename Eq>
+class MapSnapshot;
+
+// generator behind the random-fill constructor, one per thread, so threads
+// never share hidden state the way they share rand()'s
+inline std::mt19937& random_engine() {
+    thread_local std::mt19937 engine(std::random_device{}());
+    return engine;
+}
+
+// makes the calling thread's random_engine() repeatable
+inline void seed_random(unsigned int seed) {
+    random_engine().seed(seed);
+}
+
+#ifdef HASH_STATS
+// probe counts of one kind of lookup; relaxed atomics, so lookups running
+// together under a shared lock (ConcurrentUnorderedMap) may record at once
+struct ProbeStats {
+    std::atomic<unsigned long long> lookups{ 0 };
+    std::atomic<unsigned long long> probes{ 0 };
+    std::atomic<unsigned int> longest{ 0 };
+
+    void record(unsigned int n) {
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        probes.fetch_add(n, std::memory_order_relaxed);
+        unsigned int seen = longest.load(std::memory_order_relaxed);
+        while (n > seen && !longest.compare_exchange_weak(seen, n, std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        lookups = 0;
+        probes = 0;
+        longest = 0;
+    }
+
+    void write_json(std::ostream& out) const {
+        unsigned long long count = lookups.load();
+        out << "{\"lookups\": " << count << ", \"avg_probes\": " << (count ? static_cast<double>(probes.load()) / count : 0.0)
+            << ", \"max_probes\": " << longest.load() << "}";
+    }
+};
+#endif
+
+// chained hash map. Every entry keeps its full 64-bit hash: rehashing moves
+// entries by it and lookups compare it before calling Eq. When both Hash and
+// Eq declare is_transparent, lookups take any key type they accept (e.g.
+// string_view for std::string keys) without building a K.
+template<typename K = int, typename V = int, typename Hash = DefaultHash<K>, typename Eq = std::equal_to<>,
+    typename Alloc = std::allocator<std::pair<const K, V>>>
 class MyUnorderedMap {
 private:
+    friend class ConcurrentUnorderedMap<K, V, Hash, Eq, Alloc>;
+    friend class MapSnapshot<K, V, Hash, Eq>;
+
     struct KeyValuePair {
-        int key;
-        int value;
-        KeyValuePair(const int& k, const int& v) : key(k), value(v) {}
+        uint64_t hash;
+        K key;
+        V value;
+        template<typename KK, typename... Args>
+        KeyValuePair(uint64_t h, KK&& k, Args&&... args)
+            : hash(h), key(std::forward<KK>(k)), value(std::forward<Args>(args)...) {}
     };
 
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<KeyValuePair> NodeAlloc;
+    typedef std::list<KeyValuePair, NodeAlloc> Bucket;
+    typedef std::vector<Bucket, typename std::allocator_traits<Alloc>::template rebind_alloc<Bucket>> Table;
+
+    static constexpr bool transparent = requires { typename Hash::is_transparent; typename Eq::is_transparent; };
+
+    // buckets moved per operation while an incremental rehash is running
+    static constexpr unsigned int rehash_step = 4;
+
+    // keys hashed and prefetched together by the batch operations
+    static constexpr unsigned int batch_block = 16;
+
+    // bulk loads smaller than this stay on the calling thread
+    static constexpr size_t bulk_serial_limit = 1 << 16;
+
+    // bucket array bytes per bulk_load partition, about an L2, and a cap on the partition count
+    static constexpr size_t bulk_partition_bytes = 1 << 20;
+    static constexpr size_t bulk_max_partitions = 4096;
+
     // vector list for chains
-    std::vector<std::list<KeyValuePair>> table;
+    NodeAlloc alloc;
+    Table table;
     unsigned int size;
+    Hash hasher;
+    Eq equal;
+    unsigned int elements;
+    float max_load;
+    bool incremental;
 
-    unsigned int hash_function(const int& key) const {
-        std::stringstream ss;
-        ss << key;
-        std::string key_str = ss.str();
-        return pearson_hash(key_str) % size;
+    // table being drained by an incremental rehash, buckets below migrated are already moved
+    Table old_table;
+    unsigned int old_size;
+    unsigned int migrated;
+
+#ifdef HASH_STATS
+    // built with -DHASH_STATS only: entries compared per successful and failed
+    // lookup, and the number of rehashes started. Not copied with the map.
+    mutable ProbeStats hit_stats;
+    mutable ProbeStats miss_stats;
+    unsigned long long rehashes = 0;
+#endif
+
+    // the key itself when lookups are transparent (or it already is a K), a K built from it otherwise
+    template<typename KK>
+    static decltype(auto) lookup_key(const KK& key) {
+        if constexpr (transparent || std::is_same_v<KK, K>) {
+            return (key);
+        }
+        else {
+            return K(key);
+        }
+    }
+
+    // empty buckets built in place, assign() would copy one and needs a copyable V
+    Table make_table(unsigned int buckets) const {
+        Table fresh(alloc);
+        fresh.reserve(buckets);
+        for (unsigned int i = 0; i < buckets; ++i) {
+            fresh.emplace_back(alloc);
+        }
+        return fresh;
+    }
+
+    bool rehashing() const {
+        return !old_table.empty();
+    }
+
+    // the state a move leaves behind: no buckets at all (size 0), so moving
+    // needs no allocation and can be noexcept; lookups on it find nothing and
+    // the next insert gives it a bucket through ensure_table()
+    void release() noexcept {
+        table.clear();
+        old_table.clear();
+        size = old_size = migrated = 0;
+        elements = 0;
+    }
+
+    void ensure_table() {
+        if (size == 0) {
+            table = make_table(1);
+            size = 1;
+        }
+    }
+
+    // the old bucket that may still hold an entry with hash h, or nullptr
+    const Bucket* old_bucket(uint64_t h) const {
+        if (!rehashing()) return nullptr;
+        unsigned int index = bucket_index(h, old_size);
+        return index >= migrated ? &old_table[index] : nullptr;
+    }
+
+    // probes, if given, receives the number of entries compared
+    template<typename KK>
+    const KeyValuePair* find(const KK& key, uint64_t h, unsigned int* probes = nullptr) const {
+        unsigned int compared = 0;
+        const KeyValuePair* found = nullptr;
+        if (size == 0) {
+            if (probes) *probes = 0;
+            return nullptr;
+        }
+        for (const auto& pair : table[bucket_index(h, size)]) {
+            ++compared;
+            if (pair.hash == h && equal(pair.key, key)) {
+                found = &pair;
+                break;
+            }
+        }
+        if (!found) {
+            if (const Bucket* bucket = old_bucket(h)) {
+                for (const auto& pair : *bucket) {
+                    ++compared;
+                    if (pair.hash == h && equal(pair.key, key)) {
+                        found = &pair;
+                        break;
+                    }
+                }
+            }
+        }
+        if (probes) *probes = compared;
+        return found;
+    }
+
+    template<typename KK>
+    KeyValuePair* find(const KK& key, uint64_t h) {
+        return const_cast<KeyValuePair*>(static_cast<const MyUnorderedMap*>(this)->find(key, h));
+    }
+
+    // find() for the public lookups (contains, search, search_batch and the
+    // concurrent map's); only these feed the probe statistics, so the presence
+    // checks inside insert, try_emplace and bulk_load are not counted as misses
+    template<typename KK>
+    const KeyValuePair* lookup(const KK& key, uint64_t h) const {
+#ifdef HASH_STATS
+        unsigned int probes = 0;
+        const KeyValuePair* pair = find(key, h, &probes);
+        (pair ? hit_stats : miss_stats).record(probes);
+        return pair;
+#else
+        return find(key, h);
+#endif
+    }
+
+    template<typename KK>
+    KeyValuePair* lookup(const KK& key, uint64_t h) {
+        return const_cast<KeyValuePair*>(static_cast<const MyUnorderedMap*>(this)->lookup(key, h));
+    }
+
+    // links a new entry into its bucket; list nodes never move, so the
+    // returned reference survives the growth that may follow
+    template<typename KK, typename... Args>
+    KeyValuePair& emplace_new(uint64_t h, KK&& key, Args&&... args) {
+        ensure_table();
+        Bucket& bucket = table[bucket_index(h, size)];
+        bucket.emplace_back(h, std::forward<KK>(key), std::forward<Args>(args)...);
+        KeyValuePair& pair = bucket.back();
+        ++elements;
+        grow_if_needed();
+        return pair;
+    }
+
+    template<typename KK>
+    uint64_t hash_of(const KK& key) const {
+        return hasher(lookup_key(key));
+    }
+
+    // bodies of the public operations, for callers that already hold the key's hash
+
+    template<typename KK, typename... Args>
+    std::pair<V*, bool> try_emplace_hashed(uint64_t h, KK&& key, Args&&... args) {
+        rehash_step_once();
+        if (KeyValuePair* pair = find(lookup_key(key), h)) {
+            return { &pair->value, false };
+        }
+        return { &emplace_new(h, std::forward<KK>(key), std::forward<Args>(args)...).value, true };
+    }
+
+    // true if key was not there before
+    template<typename KK, typename VV>
+    bool insert_or_assign_hashed(uint64_t h, KK&& key, VV&& value) {
+        rehash_step_once();
+        if (KeyValuePair* pair = find(lookup_key(key), h)) {
+            pair->value = std::forward<VV>(value);
+            return false;
+        }
+        emplace_new(h, std::forward<KK>(key), std::forward<VV>(value));
+        return true;
+    }
+
+    template<typename KK>
+    bool erase_hashed(uint64_t h, const KK& key) {
+        rehash_step_once();
+        return remove(h, lookup_key(key));
+    }
+
+    // unlinks the entry equal to k (already a lookup key) from the new or the old table
+    template<typename KK>
+    bool remove(uint64_t h, const KK& k) {
+        if (size == 0) return false;
+        Bucket* buckets[2] = { &table[bucket_index(h, size)], const_cast<Bucket*>(old_bucket(h)) };
+        for (Bucket* bucket : buckets) {
+            if (!bucket) continue;
+            for (auto it = bucket->begin(); it != bucket->end(); ++it) {
+                if (it->hash == h && equal(it->key, k)) {
+                    bucket->erase(it);
+                    --elements;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // body(0) on the calling thread and body(1) .. body(threads - 1) on new ones
+    template<typename F>
+    static void run_parallel(unsigned int threads, F&& body) {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threads; ++t) {
+            workers.emplace_back(std::ref(body), t);
+        }
+        body(0);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // first stage of the batch operations for keys[start, start + count): the
+    // rehash work the single calls would do, then the hashes, the bucket
+    // prefetches and, once those are likely in, the first entries
+    template<typename Keys>
+    void prepare_block(const Keys& keys, size_t start, unsigned int count, uint64_t* hashes) {
+        ensure_table();
+        for (unsigned int i = 0; i < count && rehashing(); ++i) {
+            rehash_step_once();
+        }
+        for (unsigned int i = 0; i < count; ++i) {
+            hashes[i] = hash_of(keys[start + i]);
+            prefetch(&table[bucket_index(hashes[i], size)]);
+        }
+        for (unsigned int i = 0; i < count; ++i) {
+            const Bucket& bucket = table[bucket_index(hashes[i], size)];
+            if (!bucket.empty()) {
+                prefetch(&bucket.front());
+            }
+        }
+    }
+
+    // splices one old bucket into the new table, no entry is copied or rehashed
+    void migrate_bucket() {
+        Bucket& bucket = old_table[migrated++];
+        while (!bucket.empty()) {
+            Bucket& target = table[bucket_index(bucket.front().hash, size)];
+            target.splice(target.end(), bucket, bucket.begin());
+        }
+        if (migrated == old_size) {
+            Table(alloc).swap(old_table);
+            old_size = migrated = 0;
+        }
+    }
+
+    void rehash_step_once() {
+        for (unsigned int i = 0; i < rehash_step && rehashing(); ++i) {
+            migrate_bucket();
+        }
+    }
+
+    void finish_rehash() {
+        while (rehashing()) {
+            migrate_bucket();
+        }
+    }
+
+    void start_rehash(unsigned int buckets) {
+        finish_rehash();
+#ifdef HASH_STATS
+        ++rehashes;
+#endif
+        old_table.swap(table);
+        old_size = size;
+        migrated = 0;
+        size = std::max(buckets, 1u);
+        table = make_table(size);
+        if (!incremental) {
+            finish_rehash();
+        }
+    }
+
+    void grow_if_needed() {
+        if (elements > max_load * size) {
+            start_rehash(size * 2);
+        }
     }
 
 public:
-    explicit MyUnorderedMap(unsigned int table_size) : size(table_size) {
-        table.resize(size);
+    explicit MyUnorderedMap(unsigned int table_size, const Hash& hash = Hash(), const Eq& eq = Eq(), const Alloc& a = Alloc())
+        : alloc(a), table(alloc), size(std::max(table_size, 1u)), hasher(hash), equal(eq), elements(0), max_load(1.0f),
+        incremental(false), old_table(alloc), old_size(0), migrated(0) {
+        table = make_table(size);
     }
 
-    MyUnorderedMap(unsigned int table_size, unsigned int num_entries) : size(table_size) {
-        table.resize(size);
-        srand(static_cast<unsigned int>(time(nullptr)));
-        for (unsigned int i = 0; i < num_entries; ++i) {
-            int key = rand();
-            int value = rand();
-            insert(key, value);
+    // num_entries random pairs in [0, RAND_MAX], the range rand() used to give,
+    // from the calling thread's random_engine(), loaded with bulk_load
+    MyUnorderedMap(unsigned int table_size, unsigned int num_entries)
+        : MyUnorderedMap(table_size) {
+        std::mt19937& engine = random_engine();
+        std::uniform_int_distribution<int> random(0, RAND_MAX);
+        std::vector<std::pair<int, int>> pairs(num_entries);
+        for (auto& pair : pairs) {
+            pair.first = random(engine);
+            pair.second = random(engine);
         }
+        bulk_load(pairs);
     }
 
     // copy constr
-    MyUnorderedMap(const MyUnorderedMap& other) : size(other.size), table(other.table) {}
+    MyUnorderedMap(const MyUnorderedMap& other)
+        : alloc(other.alloc), table(other.table), size(other.size), hasher(other.hasher), equal(other.equal),
+        elements(other.elements), max_load(other.max_load), incremental(other.incremental), old_table(other.old_table),
+        old_size(other.old_size), migrated(other.migrated) {}
+
+    // the moved-from map is left empty with no buckets, see release()
+    MyUnorderedMap(MyUnorderedMap&& other) noexcept(std::is_nothrow_copy_constructible_v<Hash>
+        && std::is_nothrow_copy_constructible_v<Eq>)
+        : alloc(other.alloc), table(std::move(other.table)), size(other.size), hasher(other.hasher), equal(other.equal),
+        elements(other.elements), max_load(other.max_load), incremental(other.incremental),
+        old_table(std::move(other.old_table)), old_size(other.old_size), migrated(other.migrated) {
+        other.release();
+    }
 
     ~MyUnorderedMap() {}
 
@@ -84,6 +710,32 @@ public:
         if (this != &other) {
             size = other.size;
             table = other.table;
+            hasher = other.hasher;
+            equal = other.equal;
+            elements = other.elements;
+            max_load = other.max_load;
+            incremental = other.incremental;
+            old_table = other.old_table;
+            old_size = other.old_size;
+            migrated = other.migrated;
+        }
+        return *this;
+    }
+
+    MyUnorderedMap& operator=(MyUnorderedMap&& other) noexcept(std::is_nothrow_move_assignable_v<Table>
+        && std::is_nothrow_copy_assignable_v<Hash> && std::is_nothrow_copy_assignable_v<Eq>) {
+        if (this != &other) {
+            size = other.size;
+            table = std::move(other.table);
+            hasher = other.hasher;
+            equal = other.equal;
+            elements = other.elements;
+            max_load = other.max_load;
+            incremental = other.incremental;
+            old_table = std::move(other.old_table);
+            old_size = other.old_size;
+            migrated = other.migrated;
+            other.release();
         }
         return *this;
     }
@@ -94,70 +746,1516 @@ public:
                 std::cout << pair.key << ": " << pair.value << std::endl;
             }
         }
+        for (unsigned int i = migrated; i < old_size; ++i) {
+            for (const auto& pair : old_table[i]) {
+                std::cout << pair.key << ": " << pair.value << std::endl;
+            }
+        }
     }
 
-    // insert value | key
-    void insert(const int& key, const int& value) {
-        unsigned int index = hash_function(key);
-        for (auto& pair : table[index]) {
-            if (pair.key == key) {
-                return;
-            }
+    // drops every entry, one bucket left
+    void reset() {
+        Table(alloc).swap(old_table);
+        old_size = migrated = 0;
+        size = 1;
+        table = make_table(1);
+        elements = 0;
+    }
+
+    // value built from args only if key is absent; {value, inserted}
+    template<typename KK, typename... Args>
+    std::pair<V*, bool> try_emplace(KK&& key, Args&&... args) {
+        return try_emplace_hashed(hash_of(key), std::forward<KK>(key), std::forward<Args>(args)...);
+    }
+
+    // builds the entry first and drops it if the key is already present
+    template<typename KK, typename... Args>
+    std::pair<V*, bool> emplace(KK&& key, Args&&... args) {
+        rehash_step_once();
+        Bucket node(alloc);
+        node.emplace_back(0, std::forward<KK>(key), std::forward<Args>(args)...);
+        KeyValuePair& entry = node.front();
+        entry.hash = hasher(entry.key);
+        if (KeyValuePair* pair = find(entry.key, entry.hash)) {
+            return { &pair->value, false };
         }
-        table[index].push_back(KeyValuePair(key, value));
+        ensure_table();
+        Bucket& bucket = table[bucket_index(entry.hash, size)];
+        bucket.splice(bucket.end(), node);
+        ++elements;
+        grow_if_needed();
+        return { &entry.value, true };
+    }
+
+    // insert value | key
+    template<typename KK, typename VV>
+    void insert(KK&& key, VV&& value) {
+        try_emplace(std::forward<KK>(key), std::forward<VV>(value));
     }
 
     // insert or assign value | key
-    void insert_or_assign(const int& key, const int& value) {
-        unsigned int index = hash_function(key);
-        for (auto& pair : table[index]) {
-            if (pair.key == key) {
-                pair.value = value;
-                return;
+    template<typename KK, typename VV>
+    void insert_or_assign(KK&& key, VV&& value) {
+        insert_or_assign_hashed(hash_of(key), std::forward<KK>(key), std::forward<VV>(value));
+    }
+
+    template<typename KK>
+    bool contains(const KK& key) const {
+        decltype(auto) k = lookup_key(key);
+        return lookup(k, hasher(k)) != nullptr;
+    }
+
+    template<typename KK>
+    V* search(const KK& key) {
+        rehash_step_once();
+        decltype(auto) k = lookup_key(key);
+        KeyValuePair* pair = lookup(k, hasher(k));
+        return pair ? &(pair->value) : nullptr;
+    }
+
+    template<typename KK>
+    bool erase(const KK& key) {
+        return erase_hashed(hash_of(key), key);
+    }
+
+    // the batch operations below work on blocks of batch_block keys: hash the
+    // whole block and prefetch every bucket, prefetch the first entry of each,
+    // then resolve the keys, so the cache misses of a block overlap
+
+    // out[i] is the value of keys[i], or nullptr; out must hold at least as many slots as keys
+    template<typename Keys>
+    void search_batch(const Keys& keys, std::span<V*> out) {
+        uint64_t hashes[batch_block];
+        size_t n = std::size(keys);
+        if (out.size() < n) throw std::length_error("search_batch: out is shorter than keys");
+        for (size_t start = 0; start < n; start += batch_block) {
+            unsigned int count = static_cast<unsigned int>(std::min<size_t>(batch_block, n - start));
+            prepare_block(keys, start, count, hashes);
+            for (unsigned int i = 0; i < count; ++i) {
+                KeyValuePair* pair = lookup(lookup_key(keys[start + i]), hashes[i]);
+                out[start + i] = pair ? &(pair->value) : nullptr;
             }
         }
-        table[index].push_back(KeyValuePair(key, value));
     }
 
-    bool contains(const int& key) const {
-        unsigned int index = hash_function(key);
-        for (const auto& pair : table[index]) {
-            if (pair.key == key) {
-                return true;
+    // insert(keys[i], values[i]) for every i, existing keys keep their value;
+    // values must hold at least as many entries as keys
+    template<typename Keys, typename Values>
+    void insert_batch(const Keys& keys, const Values& values) {
+        uint64_t hashes[batch_block];
+        size_t n = std::size(keys);
+        if (std::size(values) < n) throw std::length_error("insert_batch: values is shorter than keys");
+        for (size_t start = 0; start < n; start += batch_block) {
+            unsigned int count = static_cast<unsigned int>(std::min<size_t>(batch_block, n - start));
+            prepare_block(keys, start, count, hashes);
+            for (unsigned int i = 0; i < count; ++i) {
+                if (!find(lookup_key(keys[start + i]), hashes[i])) {
+                    emplace_new(hashes[i], keys[start + i], values[start + i]);
+                }
             }
         }
-        return false;
     }
 
-    int* search(const int& key) {
-        unsigned int index = hash_function(key);
-        for (auto& pair : table[index]) {
-            if (pair.key == key) {
-                return &(pair.value);
+    // number of keys that were present and removed
+    template<typename Keys>
+    unsigned int erase_batch(const Keys& keys) {
+        uint64_t hashes[batch_block];
+        unsigned int erased = 0;
+        size_t n = std::size(keys);
+        for (size_t start = 0; start < n; start += batch_block) {
+            unsigned int count = static_cast<unsigned int>(std::min<size_t>(batch_block, n - start));
+            prepare_block(keys, start, count, hashes);
+            for (unsigned int i = 0; i < count; ++i) {
+                erased += remove(hashes[i], lookup_key(keys[start + i]));
             }
         }
-        return nullptr;
+        return erased;
     }
 
-    bool erase(const int& key) {
-        unsigned int index = hash_function(key);
-        for (auto it = table[index].begin(); it != table[index].end(); ++it) {
-            if (it->key == key) {
-                table[index].erase(it);
-                return true;
+    // number of keys in the map
+    unsigned int count() const {
+        return elements;
+    }
+
+    // 1 if key is in the map, 0 otherwise (bucket_size() gives the chain length)
+    template<typename KK>
+    unsigned int count(const KK& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    unsigned int bucket_count() const {
+        return size;
+    }
+
+    unsigned int bucket_size(unsigned int index) const {
+        return static_cast<unsigned int>(table[index].size());
+    }
+
+    float load_factor() const {
+        return size ? static_cast<float>(elements) / size : 0.0f;
+    }
+
+    float max_load_factor() const {
+        return max_load;
+    }
+
+    // the table grows once elements / buckets exceeds ml
+    void max_load_factor(float ml) {
+        max_load = ml;
+        grow_if_needed();
+    }
+
+    // rebuilds into at least buckets buckets (more if the load factor needs it), right away
+    void rehash(unsigned int buckets) {
+        unsigned int needed = static_cast<unsigned int>(std::ceil(elements / max_load));
+        start_rehash(std::max(buckets, needed));
+        finish_rehash();
+    }
+
+    // makes room for n elements without further growth
+    void reserve(unsigned int n) {
+        unsigned int buckets = static_cast<unsigned int>(std::ceil(n / max_load));
+        if (buckets > size) {
+            rehash(buckets);
+        }
+    }
+
+    // adds every key/value pair of pairs (anything indexable whose elements
+    // unpack into a key and a value); like insert, the first pair with a given
+    // key wins. The table is sized once for all of them. Then, on threads
+    // threads (0: one per core), the keys are hashed and the pairs
+    // radix-partitioned by the range of buckets they land in; each partition
+    // is filled by one thread only, so no bucket is shared and nothing is
+    // locked. Partitions are kept small enough that their buckets stay in
+    // cache while they are filled. The fill threads allocate nodes through
+    // alloc at the same time, which is only assumed safe for a stateless
+    // allocator (is_always_equal, like std::allocator); with any other the
+    // whole load runs on the calling thread.
+    template<typename Pairs>
+    void bulk_load(const Pairs& pairs, unsigned int threads = 0) {
+        size_t n = std::size(pairs);
+        finish_rehash();
+        reserve(static_cast<unsigned int>(std::min<size_t>(elements + n, UINT_MAX)));
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        if (n < bulk_serial_limit) threads = 1;
+        if constexpr (!std::allocator_traits<NodeAlloc>::is_always_equal::value) threads = 1;
+        unsigned int parts = std::max(threads, static_cast<unsigned int>(
+            std::min<size_t>(size * sizeof(Bucket) / bulk_partition_bytes, bulk_max_partitions)));
+
+        // pass 1: hash each chunk of the input and count its pairs per partition
+        std::vector<uint64_t> hashes(n);
+        std::vector<size_t> counts(static_cast<size_t>(threads) * parts);
+        auto chunk = [&](unsigned int t) {
+            return std::make_pair(n * t / threads, n * (t + 1) / threads);
+        };
+        auto partition = [&](uint64_t h) {
+            return static_cast<unsigned int>(static_cast<uint64_t>(bucket_index(h, size)) * parts / size);
+        };
+        run_parallel(threads, [&](unsigned int t) {
+            auto [begin, end] = chunk(t);
+            size_t* count = &counts[static_cast<size_t>(t) * parts];
+            for (size_t i = begin; i < end; ++i) {
+                const auto& [key, value] = pairs[i];
+                hashes[i] = hash_of(key);
+                ++count[partition(hashes[i])];
+            }
+        });
+
+        // partition-major prefix sums: partition p of chunk t starts at offsets[t * parts + p]
+        std::vector<size_t> offsets(counts.size());
+        std::vector<size_t> partition_begin(parts + 1, n);
+        size_t total = 0;
+        for (unsigned int p = 0; p < parts; ++p) {
+            partition_begin[p] = total;
+            for (unsigned int t = 0; t < threads; ++t) {
+                offsets[static_cast<size_t>(t) * parts + p] = total;
+                total += counts[static_cast<size_t>(t) * parts + p];
             }
         }
-        return false;
+
+        // pass 2: scatter pair indices into their partitions, input order kept inside each
+        std::vector<size_t> order(n);
+        run_parallel(threads, [&](unsigned int t) {
+            auto [begin, end] = chunk(t);
+            size_t* offset = &offsets[static_cast<size_t>(t) * parts];
+            for (size_t i = begin; i < end; ++i) {
+                order[offset[partition(hashes[i])]++] = i;
+            }
+        });
+
+        // pass 3: thread t fills partitions t, t + threads, ..., each into its own buckets
+        std::vector<unsigned int> added(threads);
+        run_parallel(threads, [&](unsigned int t) {
+            for (unsigned int p = t; p < parts; p += threads) {
+                for (size_t j = partition_begin[p]; j < partition_begin[p + 1]; ++j) {
+                    size_t i = order[j];
+                    const auto& [key, value] = pairs[i];
+                    if (!find(lookup_key(key), hashes[i])) {
+                        table[bucket_index(hashes[i], size)].emplace_back(hashes[i], key, value);
+                        ++added[t];
+                    }
+                }
+            }
+        });
+        for (unsigned int count : added) {
+            elements += count;
+        }
     }
 
-    int count(const int& key) const {
-        unsigned int index = hash_function(key);
-        return table[index].size();
+    // when on, growth moves rehash_step buckets per insert / erase / search instead of all at once
+    void set_incremental_rehash(bool on) {
+        incremental = on;
+        if (!on) {
+            finish_rehash();
+        }
+    }
+
+    // histogram[n] is the number of buckets holding n entries, over both tables during a rehash
+    std::vector<unsigned int> chain_histogram() const {
+        std::vector<unsigned int> histogram(1);
+        auto add = [&](const Bucket& bucket) {
+            size_t length = bucket.size();
+            if (length >= histogram.size()) histogram.resize(length + 1);
+            ++histogram[length];
+        };
+        for (unsigned int i = 0; i < size; ++i) {
+            add(table[i]);
+        }
+        for (unsigned int i = migrated; i < old_size; ++i) {
+            add(old_table[i]);
+        }
+        return histogram;
+    }
+
+    // the map, its bucket arrays and its list nodes (a node is the entry plus
+    // two links); memory owned by the keys and values themselves is not counted
+    size_t memory_bytes() const {
+        return sizeof(*this) + (table.capacity() + old_table.capacity()) * sizeof(Bucket)
+            + static_cast<size_t>(elements) * (sizeof(KeyValuePair) + 2 * sizeof(void*));
     }
+
+    // load, footprint and chain lengths as one JSON object; probe and rehash
+    // counts are added when built with HASH_STATS
+    void write_stats(std::ostream& out) const {
+        out << "{\"count\": " << elements << ", \"buckets\": " << size << ", \"load_factor\": " << load_factor()
+            << ", \"max_load_factor\": " << max_load << ", \"rehashing\": " << (rehashing() ? "true" : "false")
+            << ", \"memory_bytes\": " << memory_bytes() << ", \"chain_histogram\": [";
+        std::vector<unsigned int> histogram = chain_histogram();
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            out << (i ? ", " : "") << histogram[i];
+        }
+        out << "]";
+#ifdef HASH_STATS
+        out << ", \"rehashes\": " << rehashes << ", \"hits\": ";
+        hit_stats.write_json(out);
+        out << ", \"misses\": ";
+        miss_stats.write_json(out);
+#endif
+        out << "}" << std::endl;
+    }
+
+#ifdef HASH_STATS
+    void reset_stats() {
+        hit_stats.reset();
+        miss_stats.reset();
+        rehashes = 0;
+    }
+#endif
 };
 
-int main() {
-    MyUnorderedMap map(10);
+// MyUnorderedMap split into shards by the top bits of the key's hash, each
+// shard behind its own reader-writer lock. Readers of one shard run together,
+// writers only wait for writers and readers of the same shard. Shards are
+// padded to a cache line so neighbouring locks do not false-share. Values are
+// returned by copy since a pointer into a shard is not safe once its lock is
+// released.
+template<typename K, typename V, typename Hash = DefaultHash<K>, typename Eq = std::equal_to<>,
+    typename Alloc = std::allocator<std::pair<const K, V>>>
+class ConcurrentUnorderedMap {
+private:
+    typedef MyUnorderedMap<K, V, Hash, Eq, Alloc> Map;
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        Map map;
+        Shard() : map(16) {}
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    unsigned int shard_bits;
+    Hash hasher;
+
+    template<typename KK>
+    uint64_t hash_of(const KK& key) const {
+        return hasher(Map::lookup_key(key));
+    }
+
+    Shard& shard_for(uint64_t h) const {
+        return shards[shard_bits ? static_cast<unsigned int>(h >> (64 - shard_bits)) : 0];
+    }
+
+public:
+    // shard_count is rounded up to a power of two
+    explicit ConcurrentUnorderedMap(unsigned int shard_count = 64)
+        : shard_bits(std::bit_width(std::bit_ceil(std::max(shard_count, 1u)) - 1)) {
+        shards.reset(new Shard[1u << shard_bits]);
+    }
+
+    ConcurrentUnorderedMap(const ConcurrentUnorderedMap&) = delete;
+    ConcurrentUnorderedMap& operator=(const ConcurrentUnorderedMap&) = delete;
+
+    unsigned int shard_count() const {
+        return 1u << shard_bits;
+    }
+
+    // room for about n keys, spread evenly over the shards
+    void reserve(unsigned int n) {
+        for (unsigned int i = 0; i < shard_count(); ++i) {
+            std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+            shards[i].map.reserve(n / shard_count() + n / shard_count() / 4 + 1);
+        }
+    }
+
+    // true if key was inserted, false if it was already there (value left alone)
+    template<typename KK, typename VV>
+    bool insert(KK&& key, VV&& value) {
+        uint64_t h = hash_of(key);
+        Shard& shard = shard_for(h);
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        return shard.map.try_emplace_hashed(h, std::forward<KK>(key), std::forward<VV>(value)).second;
+    }
+
+    // true if key was inserted, false if an existing value was replaced
+    template<typename KK, typename VV>
+    bool insert_or_assign(KK&& key, VV&& value) {
+        uint64_t h = hash_of(key);
+        Shard& shard = shard_for(h);
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        return shard.map.insert_or_assign_hashed(h, std::forward<KK>(key), std::forward<VV>(value));
+    }
+
+    // make() runs under the shard lock and only when key is absent, so it runs at most once per key
+    template<typename KK, typename F>
+    V compute_if_absent(KK&& key, F&& make) {
+        uint64_t h = hash_of(key);
+        Shard& shard = shard_for(h);
+        {
+            std::shared_lock<std::shared_mutex> guard(shard.lock);
+            if (const auto* pair = shard.map.find(Map::lookup_key(key), h)) {
+                return pair->value;
+            }
+        }
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        if (const auto* pair = shard.map.find(Map::lookup_key(key), h)) {
+            return pair->value; // another writer got here between the two locks
+        }
+        return *shard.map.try_emplace_hashed(h, std::forward<KK>(key), make()).first;
+    }
+
+    template<typename KK>
+    bool erase(const KK& key) {
+        uint64_t h = hash_of(key);
+        Shard& shard = shard_for(h);
+        std::unique_lock<std::shared_mutex> guard(shard.lock);
+        return shard.map.erase_hashed(h, key);
+    }
+
+    template<typename KK>
+    bool contains(const KK& key) const {
+        uint64_t h = hash_of(key);
+        const Shard& shard = shard_for(h);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        return shard.map.lookup(Map::lookup_key(key), h) != nullptr;
+    }
+
+    // copies the value into out if key is present
+    template<typename KK>
+    bool search(const KK& key, V& out) const {
+        uint64_t h = hash_of(key);
+        const Shard& shard = shard_for(h);
+        std::shared_lock<std::shared_mutex> guard(shard.lock);
+        if (const auto* pair = shard.map.lookup(Map::lookup_key(key), h)) {
+            out = pair->value;
+            return true;
+        }
+        return false;
+    }
+
+    // sum over the shards, each read under its lock; only exact while no writer runs
+    unsigned int size() const {
+        unsigned int total = 0;
+        for (unsigned int i = 0; i < shard_count(); ++i) {
+            std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+            total += shards[i].map.elements;
+        }
+        return total;
+    }
+};
+
+// open-addressing map with the MyUnorderedMap API, swiss table layout:
+// a control byte per slot (empty, deleted or 7 bits of the hash) and the
+// slots themselves in one flat array. Probing walks aligned groups of 16
+// slots and matches all 16 control bytes with a single SSE2 compare.
+// search() pointers are valid until the next insert that grows the table.
+template<typename Hash = IntHash>
+class FlatUnorderedMap {
+private:
+    struct KeyValuePair {
+        int key;
+        int value;
+        KeyValuePair() : key(0), value(0) {}
+        KeyValuePair(const int& k, const int& v) : key(k), value(v) {}
+    };
+
+    static constexpr unsigned int group_size = 16;
+    static constexpr int8_t ctrl_empty = -128;
+    static constexpr int8_t ctrl_deleted = -2;
+
+    std::vector<int8_t> ctrl;
+    std::vector<KeyValuePair> slots;
+    unsigned int capacity; // power of two, multiple of group_size
+    unsigned int elements;
+    unsigned int tombstones;
+    Hash hasher;
+
+    // bit i set when control byte i of the group equals value
+    static unsigned int match(const int8_t* group, int8_t value) {
+#ifdef HASH_SSE2
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), bytes)));
+#else
+        unsigned int mask = 0;
+        for (unsigned int i = 0; i < group_size; ++i) {
+            mask |= static_cast<unsigned int>(group[i] == value) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // empty or deleted slots, both have the high bit set
+    static unsigned int match_free(const int8_t* group) {
+#ifdef HASH_SSE2
+        return static_cast<unsigned int>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        unsigned int mask = 0;
+        for (unsigned int i = 0; i < group_size; ++i) {
+            mask |= static_cast<unsigned int>(group[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    static int lowest_bit(unsigned int mask) {
+        return std::countr_zero(mask);
+    }
+
+    // slot of key, or -1
+    long long find_slot(const int& key) const {
+        uint64_t h = hasher(key);
+        int8_t h2 = static_cast<int8_t>(h & 0x7F);
+        unsigned int groups_mask = capacity / group_size - 1;
+        unsigned int group = static_cast<unsigned int>(h >> 7) & groups_mask;
+        for (unsigned int step = 1; ; ++step) {
+            const int8_t* group_ctrl = &ctrl[group * group_size];
+            for (unsigned int mask = match(group_ctrl, h2); mask; mask &= mask - 1) {
+                unsigned int slot = group * group_size + lowest_bit(mask);
+                if (slots[slot].key == key) {
+                    return slot;
+                }
+            }
+            if (match(group_ctrl, ctrl_empty)) {
+                return -1;
+            }
+            group = (group + step) & groups_mask; // triangular probing visits every group
+        }
+    }
+
+    // first empty or deleted slot on key's probe sequence
+    unsigned int free_slot(uint64_t h) const {
+        unsigned int groups_mask = capacity / group_size - 1;
+        unsigned int group = static_cast<unsigned int>(h >> 7) & groups_mask;
+        for (unsigned int step = 1; ; ++step) {
+            unsigned int mask = match_free(&ctrl[group * group_size]);
+            if (mask) {
+                return group * group_size + lowest_bit(mask);
+            }
+            group = (group + step) & groups_mask;
+        }
+    }
+
+    void resize(unsigned int new_capacity) {
+        std::vector<int8_t> old_ctrl(new_capacity, ctrl_empty);
+        std::vector<KeyValuePair> old_slots(new_capacity);
+        old_ctrl.swap(ctrl);
+        old_slots.swap(slots);
+        capacity = new_capacity;
+        tombstones = 0;
+        for (size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (old_ctrl[i] >= 0) {
+                uint64_t h = hasher(old_slots[i].key);
+                unsigned int slot = free_slot(h);
+                ctrl[slot] = static_cast<int8_t>(h & 0x7F);
+                slots[slot] = old_slots[i];
+            }
+        }
+    }
+
+    // keeps used slots, tombstones included, at or below 7/8
+    void reserve_one() {
+        if ((elements + tombstones + 1) * 8 > capacity * 7) {
+            resize(elements * 2 + 2 > capacity * 7 / 8 ? capacity * 2 : capacity); // mostly tombstones: clean in place
+        }
+    }
+
+    static unsigned int capacity_for(unsigned int n) {
+        unsigned int result = group_size;
+        while (result * 7 / 8 < n) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    KeyValuePair& place(const int& key, const int& value) {
+        reserve_one();
+        uint64_t h = hasher(key);
+        unsigned int slot = free_slot(h);
+        if (ctrl[slot] == ctrl_deleted) {
+            --tombstones;
+        }
+        ctrl[slot] = static_cast<int8_t>(h & 0x7F);
+        slots[slot] = KeyValuePair(key, value);
+        ++elements;
+        return slots[slot];
+    }
+
+public:
+    explicit FlatUnorderedMap(unsigned int table_size = 0)
+        : capacity(capacity_for(table_size)), elements(0), tombstones(0) {
+        ctrl.assign(capacity, ctrl_empty);
+        slots.resize(capacity);
+    }
+
+    void print() const {
+        for (unsigned int i = 0; i < capacity; ++i) {
+            if (ctrl[i] >= 0) {
+                std::cout << slots[i].key << ": " << slots[i].value << std::endl;
+            }
+        }
+    }
+
+    // insert value | key
+    void insert(const int& key, const int& value) {
+        if (find_slot(key) < 0) {
+            place(key, value);
+        }
+    }
+
+    // insert or assign value | key
+    void insert_or_assign(const int& key, const int& value) {
+        long long slot = find_slot(key);
+        if (slot >= 0) {
+            slots[slot].value = value;
+        }
+        else {
+            place(key, value);
+        }
+    }
+
+    bool contains(const int& key) const {
+        return find_slot(key) >= 0;
+    }
+
+    int* search(const int& key) {
+        long long slot = find_slot(key);
+        return slot >= 0 ? &slots[slot].value : nullptr;
+    }
+
+    bool erase(const int& key) {
+        long long slot = find_slot(key);
+        if (slot < 0) {
+            return false;
+        }
+        // a group with an empty slot ends every probe that reaches it, so nothing
+        // probes past it and the slot can go back to empty instead of a tombstone
+        const int8_t* group_ctrl = &ctrl[slot / group_size * group_size];
+        if (match(group_ctrl, ctrl_empty)) {
+            ctrl[slot] = ctrl_empty;
+        }
+        else {
+            ctrl[slot] = ctrl_deleted;
+            ++tombstones;
+        }
+        --elements;
+        return true;
+    }
+
+    float load_factor() const {
+        return static_cast<float>(elements) / capacity;
+    }
+
+    void reserve(unsigned int n) {
+        unsigned int needed = capacity_for(n);
+        if (needed > capacity) {
+            resize(needed);
+        }
+    }
+};
+
+// a whole file mapped read-only; the bytes are read straight from the page cache, never copied
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+
+    void unmap() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        if (file >= 0) close(file);
+        file = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+public:
+    explicit MappedFile(const std::string& path) : bytes(nullptr), length(0) {
+#ifdef _WIN32
+        mapping = nullptr;
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER info;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &info)) {
+            unmap();
+            throw std::runtime_error("cannot open " + path);
+        }
+        length = static_cast<size_t>(info.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        file = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (file < 0 || fstat(file, &info) != 0) {
+            unmap();
+            throw std::runtime_error("cannot open " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+            if (address != MAP_FAILED) {
+                bytes = static_cast<const char*>(address);
+                madvise(address, length, MADV_SEQUENTIAL);
+            }
+        }
+#endif
+        if (length > 0 && !bytes) {
+            unmap();
+            throw std::runtime_error("cannot map " + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        unmap();
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// flat on-disk form of a MyUnorderedMap, mapped read-only and searched in
+// place. Layout, all offsets relative to the file so it works wherever it
+// is mapped:
+//   Header
+//   uint64_t bucket_start[buckets + 1]   entry index where each bucket begins
+//   Entry entries[count]                 grouped by bucket: hash, key, value
+//   char strings[string_bytes]           key bytes, std::string keys only
+// Values (and non-string keys) are stored as raw bytes, so they must be
+// trivially copyable, and the file is only meant to be read back on the
+// same platform with the same Hash.
+template<typename K, typename V, typename Hash = DefaultHash<K>, typename Eq = std::equal_to<>>
+class MapSnapshot {
+private:
+    static constexpr bool string_keys = std::is_same_v<K, std::string>;
+    static_assert(string_keys || std::is_trivially_copyable_v<K>, "MapSnapshot keys must be std::string or trivially copyable");
+    static_assert(std::is_trivially_copyable_v<V>, "MapSnapshot values are read in place, they must be trivially copyable");
+
+    // a std::string key's bytes in the string area
+    struct StringRef {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    typedef std::conditional_t<string_keys, StringRef, K> StoredKey;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t count;
+        uint64_t buckets;
+        uint64_t string_bytes;
+        uint32_t key_size; // with value_size, catches opening a file with the wrong types
+        uint32_t value_size;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        StoredKey key;
+        V value;
+    };
+
+    MappedFile file;
+    const uint64_t* bucket_start;
+    const Entry* entries;
+    const char* strings;
+    uint64_t entry_count;
+    uint64_t buckets;
+    Hash hasher;
+    Eq equal;
+
+    template<typename KK>
+    bool matches(const Entry& entry, const KK& key) const {
+        if constexpr (string_keys) {
+            return std::string_view(strings + entry.key.offset, entry.key.length) == key;
+        }
+        else {
+            return equal(entry.key, key);
+        }
+    }
+
+    static std::runtime_error invalid(const std::string& path) {
+        return std::runtime_error("MapSnapshot: " + path + " is not a valid snapshot");
+    }
+
+    template<typename KK>
+    const Entry* find(const KK& key) const {
+        if (buckets == 0) return nullptr;
+        uint64_t h = hasher(key);
+        unsigned int bucket = bucket_index(h, static_cast<unsigned int>(buckets));
+        for (uint64_t i = bucket_start[bucket]; i < bucket_start[bucket + 1]; ++i) {
+            if (entries[i].hash == h && matches(entries[i], key)) {
+                return &entries[i];
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    // 2: entries hold the hashes of the permutation-based Pearson64Hash, a
+    // version 1 file of string keys would no longer find them
+    static constexpr uint32_t version = 2;
+
+    // one sequential pass over the file: header, bucket offsets from the chain
+    // lengths, then the entries bucket by bucket in blocks, then the key bytes.
+    // A pending incremental rehash is finished first, so the map's buckets are
+    // the snapshot's.
+    template<typename Alloc>
+    static void write(MyUnorderedMap<K, V, Hash, Eq, Alloc>& map, const std::string& path) {
+        map.finish_rehash();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("MapSnapshot: cannot create " + path);
+
+        Header header = { { 'H', 'M', 'A', 'P' }, version, map.elements, map.size, 0,
+            static_cast<uint32_t>(sizeof(StoredKey)), static_cast<uint32_t>(sizeof(V)) };
+        if constexpr (string_keys) {
+            for (unsigned int b = 0; b < map.size; ++b) {
+                for (const auto& pair : map.table[b]) {
+                    header.string_bytes += pair.key.size();
+                }
+            }
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<uint64_t> starts(map.size + 1);
+        for (unsigned int b = 0; b < map.size; ++b) {
+            starts[b + 1] = starts[b] + map.table[b].size();
+        }
+        out.write(reinterpret_cast<const char*>(starts.data()), starts.size() * sizeof(uint64_t));
+
+        const size_t block = 1 << 12;
+        std::vector<Entry> buffer;
+        buffer.reserve(block);
+        uint64_t string_offset = 0;
+        for (unsigned int b = 0; b < map.size; ++b) {
+            for (const auto& pair : map.table[b]) {
+                Entry entry;
+                std::memset(&entry, 0, sizeof(entry)); // padding too, so equal maps give equal files
+                entry.hash = pair.hash;
+                if constexpr (string_keys) {
+                    entry.key = { string_offset, pair.key.size() };
+                    string_offset += pair.key.size();
+                }
+                else {
+                    entry.key = pair.key;
+                }
+                entry.value = pair.value;
+                buffer.push_back(entry);
+                if (buffer.size() == block) {
+                    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Entry));
+                    buffer.clear();
+                }
+            }
+        }
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Entry));
+        if constexpr (string_keys) {
+            for (unsigned int b = 0; b < map.size; ++b) {
+                for (const auto& pair : map.table[b]) {
+                    out.write(pair.key.data(), pair.key.size());
+                }
+            }
+        }
+        if (!out) throw std::runtime_error("MapSnapshot: write to " + path + " failed");
+    }
+
+    explicit MapSnapshot(const std::string& path, const Hash& hash = Hash(), const Eq& eq = Eq())
+        : file(path), bucket_start(nullptr), entries(nullptr), strings(nullptr), entry_count(0), buckets(0),
+        hasher(hash), equal(eq) {
+        const Header* header = reinterpret_cast<const Header*>(file.data());
+        if (file.size() < sizeof(Header) || std::memcmp(header->magic, "HMAP", 4) != 0 || header->version != version
+            || header->key_size != sizeof(StoredKey) || header->value_size != sizeof(V) || header->buckets > UINT_MAX) {
+            throw invalid(path);
+        }
+        // each section is bounded by what is left of the file before it is
+        // multiplied out, so a crafted count cannot wrap the size check
+        size_t left = file.size() - sizeof(Header);
+        if (header->buckets >= left / sizeof(uint64_t)) throw invalid(path);
+        left -= static_cast<size_t>(header->buckets + 1) * sizeof(uint64_t);
+        if (header->count > left / sizeof(Entry)) throw invalid(path);
+        left -= static_cast<size_t>(header->count) * sizeof(Entry);
+        if (header->string_bytes != left) throw invalid(path);
+
+        entry_count = header->count;
+        buckets = header->buckets;
+        bucket_start = reinterpret_cast<const uint64_t*>(file.data() + sizeof(Header));
+        entries = reinterpret_cast<const Entry*>(bucket_start + buckets + 1);
+        strings = reinterpret_cast<const char*>(entries + entry_count);
+
+        // find() trusts bucket_start and the key references, so check them once here
+        if (bucket_start[0] != 0 || bucket_start[buckets] != entry_count) throw invalid(path);
+        for (uint64_t b = 0; b < buckets; ++b) {
+            if (bucket_start[b] > bucket_start[b + 1]) throw invalid(path);
+        }
+        if constexpr (string_keys) {
+            const uint64_t string_bytes = header->string_bytes;
+            for (uint64_t i = 0; i < entry_count; ++i) {
+                const StringRef& key = entries[i].key;
+                if (key.offset > string_bytes || key.length > string_bytes - key.offset) throw invalid(path);
+            }
+        }
+    }
+
+    MapSnapshot(const MapSnapshot&) = delete;
+    MapSnapshot& operator=(const MapSnapshot&) = delete;
+
+    template<typename KK>
+    bool contains(const KK& key) const {
+        return find(key) != nullptr;
+    }
+
+    // points into the mapping, valid as long as the snapshot is
+    template<typename KK>
+    const V* search(const KK& key) const {
+        const Entry* entry = find(key);
+        return entry ? &entry->value : nullptr;
+    }
+
+    // number of keys
+    uint64_t count() const {
+        return entry_count;
+    }
+
+    uint64_t bucket_count() const {
+        return buckets;
+    }
+};
+
+// one line of the scanned file: where it is and its Pearson64Hash
+struct LineRecord {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t line;
+};
+
+// "2labHASH dups <file>": walks the mapped file in blocks of lines, hashes
+// each block with pearson64_hash_many, then sorts the records so lines with
+// equal hashes sit together. Every hash shared by two or more lines is
+// reported with its distinct texts and their line numbers; more than one
+// text under a hash is a collision. Empty lines are skipped.
+void report_duplicates(const std::string& path, std::ostream& out) {
+    MappedFile file(path);
+    const char* data = file.data();
+    const size_t block_lines = 4096;
+
+    std::vector<LineRecord> records;
+    std::vector<std::string_view> block;
+    std::vector<uint64_t> hashes(block_lines);
+    block.reserve(block_lines);
+    uint32_t line = 0, first_line = 0;
+    auto flush = [&]() {
+        pearson64_hash_many(block.data(), block.size(), hashes.data());
+        for (size_t i = 0; i < block.size(); ++i) {
+            if (!block[i].empty()) {
+                records.push_back({ hashes[i], static_cast<uint64_t>(block[i].data() - data),
+                    static_cast<uint32_t>(block[i].size()), first_line + static_cast<uint32_t>(i) });
+            }
+        }
+        block.clear();
+        first_line = line;
+    };
+    for (size_t position = 0; position < file.size(); ) {
+        const char* start = data + position;
+        const char* end = static_cast<const char*>(std::memchr(start, '\n', file.size() - position));
+        size_t length = end ? static_cast<size_t>(end - start) : file.size() - position;
+        position += length + 1;
+        if (length > 0 && start[length - 1] == '\r') --length;
+        block.emplace_back(start, length);
+        ++line;
+        if (block.size() == block_lines) flush();
+    }
+    flush();
+
+    auto text = [&](const LineRecord& record) {
+        return std::string_view(data + record.offset, record.length);
+    };
+    std::sort(records.begin(), records.end(), [&](const LineRecord& a, const LineRecord& b) {
+        if (a.hash != b.hash) return a.hash < b.hash;
+        int order = text(a).compare(text(b));
+        return order != 0 ? order < 0 : a.line < b.line;
+    });
+
+    size_t groups = 0, duplicates = 0, collisions = 0;
+    for (size_t i = 0; i < records.size(); ) {
+        size_t j = i;
+        while (j < records.size() && records[j].hash == records[i].hash) ++j;
+        if (j - i > 1) {
+            ++groups;
+            std::vector<std::pair<size_t, size_t>> texts; // runs of equal text inside [i, j)
+            for (size_t k = i; k < j; ) {
+                size_t m = k;
+                while (m < j && text(records[m]) == text(records[k])) ++m;
+                texts.push_back({ k, m });
+                duplicates += m - k - 1;
+                k = m;
+            }
+            collisions += texts.size() - 1;
+            out << "hash " << std::hex << records[i].hash << std::dec << ": " << j - i << " lines";
+            if (texts.size() > 1) out << ", " << texts.size() << " different texts (collision)";
+            out << std::endl;
+            for (auto [from, to] : texts) {
+                out << "  lines";
+                for (size_t k = from; k < to; ++k) out << " " << records[k].line + 1;
+                std::string_view sample = text(records[from]).substr(0, 120);
+                out << ": " << sample << (records[from].length > sample.size() ? "..." : "") << std::endl;
+            }
+        }
+        i = j;
+    }
+    out << line << " lines, " << records.size() << " non-empty, " << groups << " hashes shared by several lines, "
+        << duplicates << " exact duplicates, " << collisions << " collisions" << std::endl;
+}
+
+template<typename Func>
+double measure_ms(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// bucket spread and insert / search throughput of one hasher
+template<typename Hash>
+void benchmark_hasher(const char* name, const std::vector<int>& keys, unsigned int table_size) {
+    MyUnorderedMap<int, int, Hash> map(table_size);
+    map.max_load_factor(1e9f); // fixed table, so the spread of the hash shows
+    double insert_time = measure_ms([&]() {
+        for (int key : keys) {
+            map.insert(key, key);
+        }
+    });
+    long long found = 0;
+    double search_time = measure_ms([&]() {
+        for (int key : keys) {
+            found += map.search(key) != nullptr;
+        }
+    });
+
+    unsigned int used = 0, longest = 0;
+    for (unsigned int i = 0; i < map.bucket_count(); ++i) {
+        unsigned int length = map.bucket_size(i);
+        used += length > 0;
+        longest = std::max(longest, length);
+    }
+    std::cout << name << ": " << used << "/" << table_size << " buckets used, longest chain " << longest
+        << ", insert " << keys.size() / insert_time / 1000.0 << " Mops/s, search "
+        << keys.size() / search_time / 1000.0 << " Mops/s (" << found << " found)" << std::endl;
+#ifdef HASH_STATS
+    map.write_stats(std::cout);
+#endif
+}
+
+void benchmark_hashers() {
+    const unsigned int table_size = 1 << 16;
+    std::vector<int> keys;
+    for (int i = 0; i < 200000; ++i) {
+        keys.push_back(i * 7 + 3);
+    }
+    benchmark_hasher<LegacyPearsonHash>("stringstream + pearson_hash", keys, table_size);
+    benchmark_hasher<Pearson64Hash>("Pearson64Hash", keys, table_size);
+    benchmark_hasher<IntHash>("IntHash", keys, table_size);
+
+    // string keys through the 8-bit and the 64-bit pearson
+    std::vector<std::string> words;
+    for (int i = 0; i < 200000; ++i) {
+        words.push_back("key_" + std::to_string(i));
+    }
+    std::vector<unsigned int> narrow(table_size), wide(table_size);
+    Pearson64Hash pearson64;
+    for (const std::string& word : words) {
+        ++narrow[pearson_hash(word) % table_size];
+        ++wide[bucket_index(pearson64(word), table_size)];
+    }
+    auto used = [](const std::vector<unsigned int>& buckets) {
+        return std::count_if(buckets.begin(), buckets.end(), [](unsigned int n) { return n > 0; });
+    };
+    std::cout << "strings: pearson_hash uses " << used(narrow) << " buckets, Pearson64Hash " << used(wide)
+        << " of " << table_size << std::endl;
+}
+
+// insert latency while the table grows from 16 buckets, with and without incremental rehash
+void benchmark_rehash() {
+    const int inserts = 1000000;
+    for (int incremental = 0; incremental < 2; ++incremental) {
+        MyUnorderedMap<int, int> map(16);
+        map.set_incremental_rehash(incremental != 0);
+        std::vector<double> latencies(inserts);
+        double total = measure_ms([&]() {
+            for (int i = 0; i < inserts; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                map.insert(i, i);
+                latencies[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            }
+        });
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << (incremental ? "incremental" : "stop-the-world") << " rehash: " << inserts << " inserts in " << total
+            << " ms, p99.9 " << latencies[inserts * 999 / 1000] << " us, max " << latencies.back() << " us, load factor "
+            << map.load_factor() << ", buckets " << map.bucket_count() << std::endl;
+    }
+}
+
+// hit and miss lookups: chained MyUnorderedMap, FlatUnorderedMap and std::unordered_map
+template<typename Map>
+void benchmark_lookups(const char* name, Map& map, const std::vector<int>& hits, const std::vector<int>& misses) {
+    long long found = 0;
+    double hit_time = measure_ms([&]() {
+        for (int key : hits) {
+            found += map.contains(key);
+        }
+    });
+    double miss_time = measure_ms([&]() {
+        for (int key : misses) {
+            found += map.contains(key);
+        }
+    });
+    std::cout << name << " size " << hits.size() << ": hit " << hit_time * 1e6 / hits.size() << " ns, miss "
+        << miss_time * 1e6 / misses.size() << " ns (" << found << " found)" << std::endl;
+}
+
+struct StdMapAdapter {
+    std::unordered_map<int, int> map;
+    bool contains(int key) const { return map.count(key) != 0; }
+};
+
+void benchmark_tables() {
+    std::mt19937 rng(7);
+    const unsigned int sizes[] = { 10000, 1000000 };
+    for (unsigned int n : sizes) {
+        std::vector<int> keys;
+        std::unordered_set<int> seen;
+        while (keys.size() < 2 * n) {
+            int key = static_cast<int>(rng());
+            if (seen.insert(key).second) keys.push_back(key);
+        }
+        std::vector<int> hits(keys.begin(), keys.begin() + n), misses(keys.begin() + n, keys.end());
+
+        MyUnorderedMap<int, int> chained(n);
+        FlatUnorderedMap<> flat(n);
+        StdMapAdapter standard;
+        standard.map.reserve(n);
+        for (int key : hits) {
+            chained.insert(key, key);
+            flat.insert(key, key);
+            standard.map.emplace(key, key);
+        }
+        std::shuffle(hits.begin(), hits.end(), rng);
+        benchmark_lookups("MyUnorderedMap", chained, hits, misses);
+        benchmark_lookups("FlatUnorderedMap", flat, hits, misses);
+        benchmark_lookups("std::unordered_map", standard, hits, misses);
+    }
+}
+
+// string keys looked up through string_view in place, and through a temporary
+// std::string the way a non-transparent map would have to
+void benchmark_string_keys() {
+    const int n = 500000;
+    std::vector<std::string> words;
+    for (int i = 0; i < n; ++i) {
+        words.push_back("user/session/" + std::to_string(i * 31));
+    }
+    std::vector<std::string_view> views(words.begin(), words.end());
+    std::shuffle(views.begin(), views.end(), std::mt19937(11));
+
+    MyUnorderedMap<std::string, int> map(n);
+    for (int i = 0; i < n; ++i) {
+        map.insert(words[i], i);
+    }
+    long long found = 0;
+    double view_time = measure_ms([&]() {
+        for (std::string_view view : views) {
+            found += map.contains(view);
+        }
+    });
+    double copy_time = measure_ms([&]() {
+        for (std::string_view view : views) {
+            found += map.contains(std::string(view));
+        }
+    });
+    std::cout << "string keys: lookup by string_view " << view_time * 1e6 / n << " ns, by std::string copy "
+        << copy_time * 1e6 / n << " ns (" << found << " found)" << std::endl;
+}
+
+// Pearson64Hash one string at a time against pearson64_hash_many, on log-line sized strings
+void benchmark_pearson_many() {
+    std::mt19937 rng(13);
+    std::vector<std::string> lines(1000000);
+    for (std::string& line : lines) {
+        line.resize(40 + rng() % 80);
+        for (char& c : line) c = static_cast<char>(' ' + rng() % 95);
+    }
+    std::vector<std::string_view> views(lines.begin(), lines.end());
+    std::vector<uint64_t> one(lines.size()), many(lines.size());
+    Pearson64Hash pearson64;
+    double one_time = measure_ms([&]() {
+        for (size_t i = 0; i < views.size(); ++i) {
+            one[i] = pearson64(views[i]);
+        }
+    });
+    double many_time = measure_ms([&]() {
+        pearson64_hash_many(views.data(), views.size(), many.data());
+    });
+    std::cout << "pearson64 of " << lines.size() << " lines: one at a time " << one_time << " ms, " << pearson_group
+        << " at a time " << many_time << " ms" << (one == many ? "" : " (MISMATCH)") << std::endl;
+}
+
+// n random pairs through insert one by one and through bulk_load on 1, 2, 4, ... threads
+void benchmark_bulk_load() {
+    const unsigned int n = 10000000;
+    seed_random(21);
+    std::uniform_int_distribution<int> random(0, INT_MAX);
+    std::vector<std::pair<int, int>> pairs(n);
+    for (auto& pair : pairs) {
+        pair.first = random(random_engine());
+        pair.second = pair.first;
+    }
+    {
+        MyUnorderedMap<int, int> map(16);
+        double time = measure_ms([&]() {
+            for (const auto& [key, value] : pairs) {
+                map.insert(key, value);
+            }
+        });
+        std::cout << "bulk load of " << n << " pairs: insert loop " << time << " ms, " << map.count() << " keys" << std::endl;
+    }
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads <= std::max(8u, cores); threads *= 2) {
+        MyUnorderedMap<int, int> map(16);
+        double time = measure_ms([&]() {
+            map.bulk_load(pairs, threads);
+        });
+        std::cout << "  bulk_load, " << threads << " threads: " << time << " ms, " << map.count() << " keys" << std::endl;
+    }
+}
+
+// restart paths for a map: rebuild it through insert, or open a snapshot and search the mapping
+void benchmark_map_snapshot() {
+    const unsigned int n = 5000000;
+    const std::string path = "2labHASH_snapshot.bin";
+    std::vector<int> keys(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        keys[i] = static_cast<int>(i * 2654435761u);
+    }
+
+    MyUnorderedMap<int, int> rebuilt(16);
+    double rebuild_time = measure_ms([&]() {
+        for (int key : keys) {
+            rebuilt.insert(key, key);
+        }
+    });
+    double write_time = measure_ms([&]() {
+        MapSnapshot<int, int>::write(rebuilt, path);
+    });
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(22));
+    long long found = 0;
+    double open_time = 0.0, mapped_time = 0.0, memory_time = 0.0;
+    {
+        std::unique_ptr<MapSnapshot<int, int>> snapshot;
+        open_time = measure_ms([&]() {
+            snapshot = std::make_unique<MapSnapshot<int, int>>(path);
+            found += snapshot->contains(keys[0]);
+        });
+        mapped_time = measure_ms([&]() {
+            for (int key : keys) {
+                found += snapshot->contains(key);
+            }
+        });
+    }
+    memory_time = measure_ms([&]() {
+        for (int key : keys) {
+            found += rebuilt.contains(key);
+        }
+    });
+    std::remove(path.c_str());
+
+    std::cout << "map snapshot of " << n << " keys: insert rebuild " << rebuild_time << " ms, write " << write_time
+        << " ms, open + first lookup " << open_time << " ms; lookups mapped " << mapped_time * 1e6 / n
+        << " ns, in memory " << memory_time * 1e6 / n << " ns (" << found << " found)" << std::endl;
+}
+
+// one-at-a-time calls against the batch API on a table well past the last level cache
+void benchmark_batches() {
+    const unsigned int n = 1u << 23;
+    std::vector<int> keys(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        keys[i] = static_cast<int>(i * 2654435761u); // odd multiplier, all distinct
+    }
+    std::vector<int> values(keys);
+
+    MyUnorderedMap<int, int> single(n), batched(n);
+    double single_insert = measure_ms([&]() {
+        for (unsigned int i = 0; i < n; ++i) {
+            single.insert(keys[i], values[i]);
+        }
+    });
+    double batch_insert = measure_ms([&]() {
+        batched.insert_batch(keys, values);
+    });
+    batched = MyUnorderedMap<int, int>(1);
+
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+    std::vector<int*> out(n);
+    long long found = 0;
+    double single_search = measure_ms([&]() {
+        for (unsigned int i = 0; i < n; ++i) {
+            found += single.search(keys[i]) != nullptr;
+        }
+    });
+    double batch_search = measure_ms([&]() {
+        single.search_batch(keys, out);
+    });
+    found += std::count_if(out.begin(), out.end(), [](int* value) { return value != nullptr; });
+
+    std::span<const int> first(keys.data(), n / 2), second(keys.data() + n / 2, n / 2);
+    double single_erase = measure_ms([&]() {
+        for (int key : first) {
+            found += single.erase(key);
+        }
+    });
+    double batch_erase = measure_ms([&]() {
+        found += single.erase_batch(second);
+    });
+
+    std::cout << n << " keys (about " << n * (sizeof(void*) * 5 + 16) / (1 << 20) << " MB of buckets and entries), ns per key, single / batch:"
+        << std::endl << "  insert " << single_insert * 1e6 / n << " / " << batch_insert * 1e6 / n
+        << " (x" << single_insert / batch_insert << ")" << std::endl
+        << "  search " << single_search * 1e6 / n << " / " << batch_search * 1e6 / n
+        << " (x" << single_search / batch_search << ")" << std::endl
+        << "  erase " << single_erase * 2e6 / n << " / " << batch_erase * 2e6 / n
+        << " (x" << single_erase / batch_erase << "), " << found << " hits" << std::endl;
+}
+
+// one mutex around the whole map, the baseline ConcurrentUnorderedMap replaces
+struct LockedMap {
+    std::mutex lock;
+    MyUnorderedMap<int, int> map{ 16 };
+    bool contains(int key) { std::lock_guard<std::mutex> guard(lock); return map.contains(key); }
+    void insert_or_assign(int key, int value) { std::lock_guard<std::mutex> guard(lock); map.insert_or_assign(key, value); }
+    bool erase(int key) { std::lock_guard<std::mutex> guard(lock); return map.erase(key); }
+};
+
+// operations per second of threads workers doing read_percent lookups, the rest split between assign and erase
+template<typename Map>
+double measure_throughput(Map& map, int threads, int read_percent, int key_range, double duration_ms) {
+    std::atomic<bool> start(false), stop(false);
+    std::atomic<long long> total_ops(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(100 + t);
+            long long ops = 0, found = 0;
+            while (!start.load()) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 256; ++i, ++ops) {
+                    uint32_t r = rng();
+                    int key = static_cast<int>((r >> 7) % key_range);
+                    int dice = static_cast<int>(r & 0x7F) * 100 / 128;
+                    if (dice < read_percent) found += map.contains(key);
+                    else if (dice & 1) map.insert_or_assign(key, i);
+                    else map.erase(key);
+                }
+            }
+            total_ops += ops + (found < 0);
+        });
+    }
+    double elapsed = measure_ms([&]() {
+        start = true;
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(duration_ms));
+        stop = true;
+        for (std::thread& worker : workers) worker.join();
+    });
+    return total_ops / elapsed * 1000.0;
+}
+
+// ConcurrentUnorderedMap against LockedMap, 1 to 64 threads and several read ratios
+void benchmark_concurrent() {
+    const int key_range = 1 << 20;
+    const int read_percents[] = { 100, 90, 50 };
+    ConcurrentUnorderedMap<int, int> sharded;
+    LockedMap locked;
+    // sized up front so no stop-the-world rehash lands inside a timed run
+    sharded.reserve(key_range);
+    locked.map.reserve(key_range);
+    for (int key = 0; key < key_range; key += 2) {
+        sharded.insert(key, key);
+        locked.insert_or_assign(key, key);
+    }
+    for (int read_percent : read_percents) {
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            double sharded_ops = measure_throughput(sharded, threads, read_percent, key_range, 100.0);
+            double locked_ops = measure_throughput(locked, threads, read_percent, key_range, 100.0);
+            std::cout << "threads " << threads << " reads " << read_percent << "%: ConcurrentUnorderedMap "
+                << sharded_ops / 1e6 << " Mops/s, locked MyUnorderedMap " << locked_ops / 1e6 << " Mops/s" << std::endl;
+        }
+    }
+}
+
+// self-checks for "2labHASH check"; a failed one is reported and the run fails
+bool check(bool ok, const char* what) {
+    if (!ok) std::cerr << "check failed: " << what << std::endl;
+    return ok;
+}
+
+// the batch calls reject spans shorter than their keys before touching anything
+bool check_batch_lengths() {
+    bool ok = true;
+    MyUnorderedMap<int, int> map(8);
+    std::vector<int> keys = { 1, 2, 3 }, values = { 10, 20 };
+    bool thrown = false;
+    try {
+        map.insert_batch(keys, values);
+    }
+    catch (const std::length_error&) {
+        thrown = true;
+    }
+    ok &= check(thrown && map.count() == 0, "insert_batch with short values throws and inserts nothing");
+    values.push_back(30);
+    map.insert_batch(keys, values);
+    ok &= check(map.count() == 3 && *map.search(3) == 30, "insert_batch with matching values inserts every key");
+
+    std::vector<int*> out(2);
+    thrown = false;
+    try {
+        map.search_batch(keys, std::span<int*>(out));
+    }
+    catch (const std::length_error&) {
+        thrown = true;
+    }
+    ok &= check(thrown, "search_batch with a short out throws");
+    return ok;
+}
+
+// long random keys: no two of them may share a 64-bit Pearson64Hash, and the
+// vector kernels of pearson64_hash_many must agree with the scalar hash
+bool check_pearson64() {
+    bool ok = true;
+    std::mt19937 rng(7);
+    std::vector<std::string> keys(200000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i].resize(i % 2 ? 200 : rng() % 256);
+        for (char& c : keys[i]) c = static_cast<char>(rng());
+    }
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    std::vector<uint64_t> one(keys.size()), many(keys.size());
+    Pearson64Hash pearson64;
+    for (size_t i = 0; i < views.size(); ++i) {
+        one[i] = pearson64(views[i]);
+    }
+    pearson64_hash_many(views.data(), views.size(), many.data());
+    ok &= check(one == many, "pearson64_hash_many matches Pearson64Hash");
+
+    std::unordered_set<std::string_view> distinct(views.begin(), views.end());
+    std::sort(one.begin(), one.end());
+    size_t hashes = std::unique(one.begin(), one.end()) - one.begin();
+    ok &= check(hashes == distinct.size(), "no 64-bit Pearson64Hash collisions among long keys");
+    return ok;
+}
+
+int run_checks() {
+    bool ok = check_batch_lengths();
+    ok &= check_pearson64();
+    std::cout << (ok ? "all checks passed" : "some checks failed") << std::endl;
+    return ok ? 0 : 1;
+}
+
+// "2labHASH bench" runs the benchmarks, "2labHASH check" the self-checks and
+// "2labHASH dups <file>" the duplicate line report instead of the demo
+int main(int argc, char* argv[]) {
+    if (argc > 2 && std::string(argv[1]) == "dups") {
+        try {
+            report_duplicates(argv[2], std::cout);
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        benchmark_hashers();
+        benchmark_pearson_many();
+        benchmark_rehash();
+        benchmark_tables();
+        benchmark_string_keys();
+        benchmark_batches();
+        benchmark_bulk_load();
+        benchmark_map_snapshot();
+        benchmark_concurrent();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "check") {
+        return run_checks();
+    }
+
+    MyUnorderedMap<int, int> map(10);
 
     map.insert(1, 10);
     map.insert(2, 20);
@@ -170,6 +2268,7 @@ int main() {
     map.erase(2);
     std::cout << "after erasing key 2:" << std::endl;
     map.print();
+    std::cout << "keys: " << map.count() << std::endl;
 
 
     std::string input1, input2;
@@ -7,6 +7,282 @@
 #include <queue>
 #include <functional>
 #include <iterator>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <string>
+#include <chrono>
+#include <random>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRAPH_SSE2
+#endif
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#ifdef __AVX__
+#define GRAPH_AVX
+#endif
+#ifdef __AVX512F__
+#define GRAPH_AVX512
+#endif
+
+
+// d-арная куча с минимумом на вершине; при D = 4 дерево вдвое ниже двоичного,
+// а все дети узла лежат рядом в памяти, поэтому просеивание вниз дешевле
+template<typename T, typename Less = std::less<T>, size_t D = 4>
+class DaryHeap {
+public:
+    bool empty() const {
+        return _items.empty();
+    }
+
+    const T& top() const {
+        return _items.front();
+    }
+
+    void push(T item) {
+        // просеивание вверх: поднимаем новый элемент, пока он меньше родителя
+        size_t i = _items.size();
+        _items.push_back(std::move(item));
+        T moving = std::move(_items[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / D;
+            if (!_less(moving, _items[parent]))
+                break;
+            _items[i] = std::move(_items[parent]);
+            i = parent;
+        }
+        _items[i] = std::move(moving);
+    }
+
+    void pop() {
+        T moving = std::move(_items.back());
+        _items.pop_back();
+        if (_items.empty())
+            return;
+        // просеивание вниз: ставим последний элемент в корень и опускаем к наименьшему из детей
+        size_t i = 0;
+        const size_t n = _items.size();
+        for (;;) {
+            size_t first = i * D + 1;
+            if (first >= n)
+                break;
+            size_t last = std::min(first + D, n);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c) {
+                if (_less(_items[c], _items[best]))
+                    best = c;
+            }
+            if (!_less(_items[best], moving))
+                break;
+            _items[i] = std::move(_items[best]);
+            i = best;
+        }
+        _items[i] = std::move(moving);
+    }
+
+private:
+    std::vector<T> _items;
+    Less _less;
+};
+
+// пул потоков с кражей работы для параллельных циклов. потоки создаются один раз при первом цикле
+// и спят между циклами. индексы цикла режутся на блоки, каждый поток получает свою непрерывную полосу
+// блоков и берёт их с конца своей очереди, а закончивший поток забирает блоки из начала чужих очередей,
+// поэтому неравные по времени блоки не оставляют потоки без дела
+class WorkStealingPool {
+public:
+    static WorkStealingPool& instance() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    // число участников цикла вместе с вызывающим потоком; номера worker в body меньше него
+    size_t size() const {
+        return _queues.size();
+    }
+
+    // body(worker, i) вызывается для всех i из [0, count), блоками по block индексов.
+    // циклы из разных потоков выполняются по очереди; body не должен сам вызывать parallel_for
+    template<typename Body>
+    void parallel_for(size_t count, size_t block, Body body) {
+        const size_t blocks = (count + block - 1) / block;
+        if (blocks == 0)
+            return;
+        auto run_block = [&](size_t worker, size_t b) {
+            for (size_t i = b * block; i < std::min(count, (b + 1) * block); ++i)
+                body(worker, i);
+        };
+
+        std::lock_guard<std::mutex> submit(_submit);
+        const size_t threads = size();
+        if (threads == 1 || blocks == 1) { // будить потоки ради одного блока дороже, чем посчитать его
+            for (size_t b = 0; b < blocks; ++b)
+                run_block(0, b);
+            return;
+        }
+
+        for (size_t b = 0; b < blocks; ++b)
+            _queues[b * threads / blocks].blocks.push_back(b);
+        _job = run_block;
+        _error = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(_state);
+            _active = threads - 1;
+            ++_generation;
+        }
+        _wake.notify_all();
+
+        drain(0); // вызывающий поток работает наравне с остальными
+        {
+            std::unique_lock<std::mutex> guard(_state);
+            _done.wait(guard, [this]() { return _active == 0; });
+        }
+        _job = nullptr;
+        if (_error)
+            std::rethrow_exception(_error);
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+private:
+    struct alignas(64) Queue {
+        std::mutex lock;
+        std::deque<size_t> blocks;
+    };
+
+    std::vector<Queue> _queues;
+    std::vector<std::thread> _workers;
+    std::mutex _submit; // один цикл за раз
+    std::mutex _state;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    size_t _generation = 0; // номер текущего цикла, по его смене потоки просыпаются
+    size_t _active = 0; // потоков, ещё не закончивших текущий цикл
+    bool _stopping = false;
+    std::function<void(size_t, size_t)> _job;
+    std::exception_ptr _error;
+
+    WorkStealingPool()
+        : _queues(std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t t = 1; t < _queues.size(); ++t)
+            _workers.emplace_back([this, t]() { serve(t); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> guard(_state);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (auto& worker : _workers)
+            worker.join();
+    }
+
+    void serve(size_t self) {
+        size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> guard(_state);
+                _wake.wait(guard, [&]() { return _stopping || _generation != seen; });
+                if (_stopping)
+                    return;
+                seen = _generation;
+            }
+            drain(self);
+            std::lock_guard<std::mutex> guard(_state);
+            if (--_active == 0)
+                _done.notify_one();
+        }
+    }
+
+    // берёт блоки из своей очереди, потом крадёт у соседей, пока блоки не кончатся
+    void drain(size_t self) {
+        const size_t threads = size();
+        for (;;) {
+            size_t b = 0;
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> guard(_queues[self].lock);
+                if (!_queues[self].blocks.empty()) {
+                    b = _queues[self].blocks.back();
+                    _queues[self].blocks.pop_back();
+                    found = true;
+                }
+            }
+            for (size_t k = 1; !found && k < threads; ++k) { // своя очередь пуста - крадём у соседей
+                Queue& victim = _queues[(self + k) % threads];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if (!victim.blocks.empty()) {
+                    b = victim.blocks.front();
+                    victim.blocks.pop_front();
+                    found = true;
+                }
+            }
+            if (!found) // новые блоки в цикле не появляются, значит работа закончена
+                return;
+            try {
+                _job(self, b);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(_state);
+                if (!_error)
+                    _error = std::current_exception();
+            }
+        }
+    }
+};
+
+// параллельный цикл на общем пуле: body(worker, i) для всех i из [0, count)
+template<typename Body>
+void parallel_for(size_t count, size_t block, Body body) {
+    WorkStealingPool::instance().parallel_for(count, block, body);
+}
+
+// строка min-plus для флойда - уоршелла: row[j] = min(row[j], through + pivot[j]);
+// клетки pivot, равные infinity, пропускаются, чтобы у целых весов не было переполнения
+template<typename Distance>
+inline void min_plus_row(Distance* row, const Distance* pivot, Distance through, Distance infinity, size_t count) {
+    for (size_t j = 0; j < count; ++j) {
+        if (pivot[j] < infinity)
+            row[j] = std::min(row[j], through + pivot[j]);
+    }
+}
+
+// для double бесконечность поглощает сложение, поэтому проверка не нужна и строка считается векторами
+inline void min_plus_row(double* row, const double* pivot, double through, double, size_t count) {
+    size_t j = 0;
+#if defined(GRAPH_AVX512)
+    __m512d through8 = _mm512_set1_pd(through);
+    for (; j + 8 <= count; j += 8) {
+        __m512d candidate = _mm512_add_pd(through8, _mm512_loadu_pd(pivot + j));
+        _mm512_storeu_pd(row + j, _mm512_min_pd(_mm512_loadu_pd(row + j), candidate));
+    }
+#elif defined(GRAPH_AVX)
+    __m256d through4 = _mm256_set1_pd(through);
+    for (; j + 4 <= count; j += 4) {
+        __m256d candidate = _mm256_add_pd(through4, _mm256_loadu_pd(pivot + j));
+        _mm256_storeu_pd(row + j, _mm256_min_pd(_mm256_loadu_pd(row + j), candidate));
+    }
+#elif defined(GRAPH_SSE2)
+    __m128d through2 = _mm_set1_pd(through);
+    for (; j + 2 <= count; j += 2) {
+        __m128d candidate = _mm_add_pd(through2, _mm_loadu_pd(pivot + j));
+        _mm_storeu_pd(row + j, _mm_min_pd(_mm_loadu_pd(row + j), candidate));
+    }
+#endif
+    for (; j < count; ++j)
+        row[j] = std::min(row[j], through + pivot[j]);
+}
 
 
 template<typename Vertex, typename Distance = double>
@@ -27,17 +303,19 @@ public:
             throw std::invalid_argument("Вершина уже существует в графе");
         _vertices.insert(v);
         _edges.emplace(v, std::vector<Edge>{});
+        invalidate();
     }
 
     bool remove_vertex(const Vertex& v) {
         if (!has_vertex(v)) return false;
         _vertices.erase(v);
+        _negative_edges -= std::count_if(_edges[v].begin(), _edges[v].end(), is_negative);
         _edges.erase(v);
         for (auto& kv : _edges) {
             auto& list_edge = kv.second; // Получаем ссылку на вектор рёбер, который связан с текущей вершиной
-            list_edge.erase(std::remove_if(list_edge.begin(), list_edge.end(),
-                [v](const Edge& e) { return e.to == v; }), list_edge.end());
+            drop_edges(list_edge, [v](const Edge& e) { return e.to == v; });
         }
+        invalidate();
         return true;
     }
 
@@ -45,17 +323,17 @@ public:
         if (!has_vertex(from) || !has_vertex(to))
             throw std::out_of_range("Вершина не существует в графе");
         _edges[from].push_back({ from, to, d });
+        if (is_negative(_edges[from].back()))
+            ++_negative_edges;
+        invalidate();
     }
 
     // между двумя вершинами
     bool remove_edge(const Vertex& from, const Vertex& to) {
         if (!has_vertex(from) || !has_vertex(to))
             return false;
-        auto& list = _edges[from];
-        auto it = std::remove_if(list.begin(), list.end(),
-            [to](const Edge& e) { return e.to == to; });
-        if (it != list.end()) {
-            list.erase(it, list.end());
+        if (drop_edges(_edges[from], [to](const Edge& e) { return e.to == to; })) {
+            invalidate();
             return true;
         }
         return false;
@@ -65,11 +343,9 @@ public:
     bool remove_edge(const Edge& e) {
         if (!has_vertex(e.from) || !has_vertex(e.to))
             return false;
-        auto& list = _edges[e.from];
-        auto it = std::remove_if(list.begin(), list.end(),
-            [&e](const Edge& edg) { return e.from == edg.from && e.to == edg.to && e.distance == edg.distance; });
-        if (it != list.end()) {
-            list.erase(it, list.end());
+        if (drop_edges(_edges[e.from],
+            [&e](const Edge& edg) { return e.from == edg.from && e.to == edg.to && e.distance == edg.distance; })) {
+            invalidate();
             return true;
         }
         return false;
@@ -117,56 +393,175 @@ public:
         return degree;
     }
 
-    // беллман - форд
+    // кратчайший путь: Дейкстра с ранним выходом, если в графе нет отрицательных рёбер,
+    // иначе Беллман - Форд
     std::vector<Edge> shortest_path(const Vertex& from, const Vertex& to) const {
         if (!has_vertex(from) || !has_vertex(to))
             throw std::invalid_argument("Вершина не существует в графе");
 
-        std::unordered_map<Vertex, Distance> distance; // словарь расстояний
-        std::unordered_map<Vertex, Edge> predecessor; // словарь предшественников
+        const Compact& g = compact();
+        const size_t source = g.index.at(from);
+        const size_t target = g.index.at(to);
+        std::vector<Distance> distance(g.vertices.size(), unreachable()); // расстояния по номерам вершин
+        std::vector<size_t> via(g.vertices.size(), npos); // номер ребра, по которому пришли в вершину
+        std::vector<size_t> parent(g.vertices.size(), npos); // вершина, из которой пришли
+
+        distance[source] = Distance(); // дистанция от начальной до начальной равно нулю
+        if (_negative_edges > 0)
+            bellman_ford(g, distance, via, parent);
+        else
+            dijkstra(g, g.weights, source, target, distance, via, parent);
 
-        // приравниваем расстояния до всех вершин бесконечности, а до предшественников пустым ребром
-        for (const Vertex& v : _vertices) {
-            distance[v] = std::numeric_limits<Distance>::infinity();
-            predecessor[v] = Edge();
+        std::vector<Edge> path;
+        // начиная с конечной вершины, добавляем рёбра в путь, используя информацию о предшественниках
+        for (size_t v = target; v != source && via[v] != npos; v = parent[v]) {
+            path.push_back({ g.vertices[parent[v]], g.vertices[v], g.weights[via[v]] });
         }
+        std::reverse(path.begin(), path.end()); // реверс чтобы вершины были упорядочены от начальной к конечной
+        return path;
+    }
 
-        distance[from] = Distance(); // дистанция от начальной до начальной равно нулю
+    // матрица кратчайших расстояний между всеми парами вершин
+    class DistanceMatrix {
+    public:
+        size_t order() const {
+            return _vertices.size();
+        }
 
-        // Многократное ослабление рёбер
-        for (size_t i = 1; i < _vertices.size(); ++i) {
-            for (const auto& kv : _edges) { // цикл по вершинам
-                const Vertex& u = kv.first; // получаем текущую вершину u и ее исхходящие ребра
-                for (const Edge& e : kv.second) { // проходим по всем исходящим ребрам из вершины u -
-                    Vertex v = e.to; // вершина в которую идет текущее ребро
-                    Distance weight = e.distance;
-                    if (distance[u] + weight < distance[v]) { // если можем улучшить текущее расстояние до вершины v через вершину u
-                        distance[v] = distance[u] + weight; // то обновляем расстояние до вершины v
-                        predecessor[v] = e; // запоминаем предшествующее ребро для вершины v
-                    }
+        bool has_vertex(const Vertex& v) const {
+            return _index.count(v) > 0;
+        }
+
+        // расстояние от from до to; если пути нет - бесконечность (для целых весов - максимум типа)
+        Distance distance(const Vertex& from, const Vertex& to) const {
+            if (!has_vertex(from) || !has_vertex(to))
+                throw std::invalid_argument("Вершина не существует в матрице");
+            Distance value = cell(_index.at(from), _index.at(to));
+            return value < dense_infinity() ? value : unreachable();
+        }
+
+        bool reachable(const Vertex& from, const Vertex& to) const {
+            return distance(from, to) != unreachable();
+        }
+
+    private:
+        friend class Graph;
+
+        std::vector<Vertex> _vertices; // номер строки -> вершина
+        std::unordered_map<Vertex, size_t> _index;
+        size_t _stride = 0; // длина строки, кратная размеру плитки
+        std::vector<Distance> _cells;
+
+        Distance& cell(size_t from, size_t to) {
+            return _cells[from * _stride + to];
+        }
+
+        const Distance& cell(size_t from, size_t to) const {
+            return _cells[from * _stride + to];
+        }
+    };
+
+    // все пары кратчайших расстояний флойдом - уоршеллом по плиткам dense_tile x dense_tile:
+    // для каждого блока промежуточных вершин сначала считается диагональная плитка, затем её строка
+    // и столбец, затем все остальные плитки; плитки одной фазы независимы и считаются параллельно
+    DistanceMatrix all_pairs() const {
+        const Compact& g = compact();
+        const size_t n = g.vertices.size();
+        const size_t tiles = (n + dense_tile - 1) / dense_tile;
+        const Distance infinity = dense_infinity();
+
+        DistanceMatrix m;
+        m._vertices = g.vertices;
+        m._index = g.index;
+        m._stride = tiles * dense_tile;
+        m._cells.assign(m._stride * m._stride, infinity); // лишние строки и столбцы - изолированные вершины
+        for (size_t v = 0; v < m._stride; ++v)
+            m.cell(v, v) = Distance();
+        for (size_t u = 0; u < n; ++u) {
+            for (size_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k)
+                m.cell(u, g.targets[k]) = std::min(m.cell(u, g.targets[k]), g.weights[k]);
+        }
+
+        // плитка (row, column) через промежуточные вершины [first, last)
+        auto relax_tile = [&m, infinity](size_t row, size_t column, size_t first, size_t last) {
+            for (size_t k = first; k < last; ++k) {
+                const Distance* through_row = &m.cell(k, column * dense_tile);
+                for (size_t i = row * dense_tile; i < (row + 1) * dense_tile; ++i) {
+                    Distance through = m.cell(i, k);
+                    if (through < infinity)
+                        min_plus_row(&m.cell(i, column * dense_tile), through_row, through, infinity, dense_tile);
                 }
             }
-        }
+        };
 
-        // Проверка на наличие отрицательных циклов
-        for (const auto& kv : _edges) {
-            const Vertex& u = kv.first; // проходим по всем вершинам в графе
-            for (const Edge& e : kv.second) { // цикл по всем исходящим ребрам из вершины u
-                Vertex v = e.to;
-                Distance weight = e.distance;
-                if (distance[u] + weight < distance[v]) { // еслим можем улучшить расстояние до v через u значит есть отриц. цикл
+        // отрицательный цикл ловится сразу после появления, пока значения на нём не разрослись до переполнения
+        auto check_diagonal = [&m](size_t first, size_t last) {
+            for (size_t v = first; v < last; ++v) {
+                if (m.cell(v, v) < Distance())
                     throw std::runtime_error("Граф содержит отрицательный цикл");
-                }
             }
+        };
+
+        for (size_t pivot = 0; pivot < tiles; ++pivot) {
+            const size_t first = pivot * dense_tile;
+            const size_t last = first + dense_tile;
+            for (size_t k = first; k < last; ++k) { // внутри диагональной плитки цикл может появиться на любом шаге
+                relax_tile(pivot, pivot, k, k + 1);
+                check_diagonal(first, last);
+            }
+            parallel_for(2 * tiles, 1, [&](size_t, size_t t) {
+                size_t other = t / 2;
+                if (other == pivot)
+                    return;
+                if (t % 2 == 0)
+                    relax_tile(pivot, other, first, last);
+                else
+                    relax_tile(other, pivot, first, last);
+            });
+            parallel_for(tiles * tiles, 1, [&](size_t, size_t t) {
+                size_t row = t / tiles;
+                size_t column = t % tiles;
+                if (row != pivot && column != pivot)
+                    relax_tile(row, column, first, last);
+            });
+            check_diagonal(0, n);
         }
+        return m;
+    }
 
-        std::vector<Edge> path;
-        // начиная с конечной вершины, добавляем рёбра в путь, используя информацию о предшественниках
-        for (Vertex v = to; predecessor[v].from != Vertex(); v = predecessor[v].from) {
-            path.push_back(predecessor[v]); // добавляем предшествующее ребро в путь
+    // расстояния для набора пар (from, to); недостижимым парам соответствует бесконечность
+    // (для целых весов - максимум типа). плотный граф считается матрицей целиком,
+    // разреженный - одним поиском из каждого различного источника
+    std::vector<Distance> distances(const std::vector<std::pair<Vertex, Vertex>>& pairs) const {
+        for (const auto& pair : pairs) {
+            if (!has_vertex(pair.first) || !has_vertex(pair.second))
+                throw std::invalid_argument("Вершина не существует в графе");
         }
-        std::reverse(path.begin(), path.end()); // реверс чтобы вершины были упорядочены от начальной к конечной
-        return path;
+        std::vector<Distance> result(pairs.size());
+        const Compact& g = compact();
+        if (prefers_dense(g)) {
+            DistanceMatrix m = all_pairs();
+            for (size_t q = 0; q < pairs.size(); ++q)
+                result[q] = m.distance(pairs[q].first, pairs[q].second);
+            return result;
+        }
+
+        // запросы, сгруппированные по источнику
+        std::unordered_map<size_t, std::vector<size_t>> by_source;
+        for (size_t q = 0; q < pairs.size(); ++q)
+            by_source[g.index.at(pairs[q].first)].push_back(q);
+        std::vector<size_t> sources;
+        std::vector<const std::vector<size_t>*> queries;
+        for (const auto& kv : by_source) {
+            sources.push_back(kv.first);
+            queries.push_back(&kv.second);
+        }
+
+        for_each_source(g, sources, [&](size_t slot, const std::vector<Distance>& distance) {
+            for (size_t q : *queries[slot])
+                result[q] = distance[g.index.at(pairs[q].second)];
+        });
+        return result;
     }
 
     // обход графа в ширину начиная с указанной вершины с выполнением действия над каждой вершиной
@@ -194,53 +589,320 @@ public:
         }
     }
 
-    // находит самый удаленный травмпункт на основе среднего расстояния до всех других травмпунктов
-    Vertex find_furthest_hospital() {
-        std::unordered_map<Vertex, double> avg_distances; // хэш таблица для хранения средних расстояний до всех вершин
+    // находит самый удаленный травмпункт на основе среднего расстояния до всех других травмпунктов;
+    // вершина, из которой часть травмпунктов недостижима, считается дальше любой, из которой достижимы все.
+    // при равной удалённости выбирается меньшая вершина, чтобы ответ не зависел от порядка хэш-таблицы
+    Vertex find_furthest_hospital() const {
+        if (_vertices.empty())
+            return Vertex();
 
-        std::unordered_set<Vertex> vertices_ = vertices(); // получаем все вершины графа
+        const Compact& g = compact();
+        std::vector<Remoteness> remoteness = prefers_dense(g) ? average_distances(all_pairs()) : average_distances(g);
 
-        for (const auto& v : vertices_) { // для каждой вершины из множества вершин
-            double total_distance = 0.0;
-            int num_neighbors = 0;
-
-            for (const auto& u : vertices_) {
-                if (u != v) { // убираем текующую вершину из рассмотрения
-                    std::vector<Edge> path = shortest_path(v, u); // кратчайший путь от текущей вершины до соседней
-                    double path_distance = 0.0; // длина найденного пути
-                    for (const auto& edge : path) { // ищем длину найденного пути
-                        path_distance += edge.distance;
-                    }
-                    total_distance += path_distance; // обновляем суммарное расстояние и количество соседних вершин
-                    num_neighbors++;
+        size_t furthest = 0;
+        for (size_t v = 1; v < remoteness.size(); ++v) { // выбираем вершину с макс авераг расстоянием
+            bool tie = !(remoteness[v] < remoteness[furthest]) && !(remoteness[furthest] < remoteness[v]);
+            if (remoteness[furthest] < remoteness[v] || (tie && g.vertices[v] < g.vertices[furthest]))
+                furthest = v;
+        }
+        return g.vertices[furthest];
+    }
+
+private:
+    // сжатое представление графа для поиска путей: вершины пронумерованы подряд,
+    // исходящие рёбра вершины i лежат в [offsets[i], offsets[i + 1]) массивов targets и weights
+    struct Compact {
+        std::vector<Vertex> vertices; // номер -> вершина
+        std::unordered_map<Vertex, size_t> index; // вершина -> номер
+        std::vector<size_t> offsets;
+        std::vector<size_t> targets;
+        std::vector<Distance> weights;
+    };
+
+    // удалённость вершины от остальных: сначала сравнивается число недостижимых вершин,
+    // затем среднее расстояние до достижимых
+    struct Remoteness {
+        size_t unreachable = 0;
+        double average = 0.0;
+
+        bool operator<(const Remoteness& other) const {
+            if (unreachable != other.unreachable)
+                return unreachable < other.unreachable;
+            return average < other.average;
+        }
+    };
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    // источников в одном блоке параллельного цикла
+    static constexpr size_t sources_per_block = 16;
+    // сторона плитки флойда - уоршелла: три плитки double по 128 КБ помещаются в L2,
+    // а строка плитки достаточно длинная для векторного min-plus
+    static constexpr size_t dense_tile = 128;
+    // матрица выбирается при E >= V^2 / dense_density и не более dense_max_order вершинах
+    static constexpr size_t dense_density = 4;
+    static constexpr size_t dense_max_order = 2048;
+
+    // кэш сжатого представления: константные запросы из разных потоков строят его под мьютексом,
+    // а читают через atomic_load. мьютекс не копируется, поэтому копия графа начинает с пустого кэша
+    struct CompactCache {
+        std::mutex lock;
+        std::shared_ptr<const Compact> view;
+
+        CompactCache() = default;
+        CompactCache(const CompactCache&) {}
+        CompactCache& operator=(const CompactCache&) {
+            std::atomic_store(&view, std::shared_ptr<const Compact>());
+            return *this;
+        }
+    };
+
+    // хранение вершин
+    std::unordered_set<Vertex> _vertices;
+    // хранение рёбер
+    std::unordered_map<Vertex, std::vector<Edge>> _edges;
+    // число рёбер с отрицательным весом: пока оно ноль, пути ищет Дейкстра
+    size_t _negative_edges = 0;
+    // строится при первом поиске пути и сбрасывается при любом изменении графа
+    mutable CompactCache _compact;
+
+    static bool is_negative(const Edge& e) {
+        return e.distance < Distance();
+    }
+
+    // расстояние до недостижимой вершины; для целых весов бесконечности нет
+    static Distance unreachable() {
+        if (std::numeric_limits<Distance>::has_infinity)
+            return std::numeric_limits<Distance>::infinity();
+        return std::numeric_limits<Distance>::max();
+    }
+
+    // недостижимость в клетках матрицы; у целых весов берётся половина максимума,
+    // чтобы сумма двух клеток не переполнялась
+    static Distance dense_infinity() {
+        if (std::numeric_limits<Distance>::has_infinity)
+            return std::numeric_limits<Distance>::infinity();
+        return std::numeric_limits<Distance>::max() / 2;
+    }
+
+    bool prefers_dense(const Compact& g) const {
+        const size_t n = g.vertices.size();
+        return n <= dense_max_order && g.targets.size() * dense_density >= n * n;
+    }
+
+    // удаляет из списка рёбра, подходящие под условие, поддерживая счётчик отрицательных рёбер;
+    // возвращает, было ли что-то удалено
+    template<typename Predicate>
+    bool drop_edges(std::vector<Edge>& list, Predicate pred) {
+        _negative_edges -= std::count_if(list.begin(), list.end(),
+            [&pred](const Edge& e) { return pred(e) && is_negative(e); });
+        auto it = std::remove_if(list.begin(), list.end(), pred);
+        if (it == list.end())
+            return false;
+        list.erase(it, list.end());
+        return true;
+    }
+
+    void invalidate() {
+        std::atomic_store(&_compact.view, std::shared_ptr<const Compact>());
+    }
+
+    // представление живёт в кэше до следующего изменения графа; изменять граф параллельно с запросами нельзя
+    const Compact& compact() const {
+        std::shared_ptr<const Compact> view = std::atomic_load(&_compact.view);
+        if (view)
+            return *view;
+
+        std::lock_guard<std::mutex> guard(_compact.lock);
+        view = std::atomic_load(&_compact.view); // другой поток мог построить его, пока мы ждали мьютекс
+        if (!view) {
+            auto g = std::make_shared<Compact>();
+            g->vertices.assign(_vertices.begin(), _vertices.end());
+            g->index.reserve(g->vertices.size());
+            for (size_t i = 0; i < g->vertices.size(); ++i)
+                g->index.emplace(g->vertices[i], i);
+
+            size_t edge_count = 0;
+            for (const auto& kv : _edges)
+                edge_count += kv.second.size();
+            g->offsets.reserve(g->vertices.size() + 1);
+            g->targets.reserve(edge_count);
+            g->weights.reserve(edge_count);
+            g->offsets.push_back(0);
+            for (const Vertex& v : g->vertices) {
+                for (const Edge& e : _edges.at(v)) {
+                    g->targets.push_back(g->index.at(e.to));
+                    g->weights.push_back(e.distance);
                 }
+                g->offsets.push_back(g->targets.size());
             }
-            if (num_neighbors > 0) { // если есть сосед, то ищем среднее расстояние
-                avg_distances[v] = total_distance / num_neighbors;
+            view = std::move(g);
+            std::atomic_store(&_compact.view, view);
+        }
+        return *view;
+    }
+
+    // дейкстра на 4-арной куче; записи в куче не обновляются, а устаревшие пропускаются при извлечении
+    // при target == npos считает расстояния до всех вершин
+    static void dijkstra(const Compact& g, const std::vector<Distance>& weights, size_t source, size_t target,
+        std::vector<Distance>& distance, std::vector<size_t>& via, std::vector<size_t>& parent) {
+        using Item = std::pair<Distance, size_t>;
+        DaryHeap<Item> heap;
+        heap.push({ Distance(), source });
+        while (!heap.empty()) {
+            auto [d, u] = heap.top();
+            heap.pop();
+            if (d > distance[u]) // вершина уже закрыта с меньшим расстоянием
+                continue;
+            if (u == target) // расстояние до конечной вершины окончательное, дальше искать незачем
+                break;
+            for (size_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k) {
+                size_t v = g.targets[k];
+                Distance candidate = d + weights[k];
+                if (candidate < distance[v]) {
+                    distance[v] = candidate;
+                    via[v] = k;
+                    parent[v] = u;
+                    heap.push({ candidate, v });
+                }
             }
         }
+    }
 
-        Vertex furthest_hospital;
-        double max_avg_distance = -1.0; // для хранения вершины с самым большим средним расстоянием и этим расстоянеим
+    // беллман - форд от вершин, расстояния до которых уже заданы в distance;
+    // проходы прекращаются, как только ни одно расстояние не улучшилось
+    static void bellman_ford(const Compact& g, std::vector<Distance>& distance,
+        std::vector<size_t>& via, std::vector<size_t>& parent) {
+        const size_t n = g.vertices.size();
 
-        for (const auto& pair : avg_distances) { // выбираем вершину с макс авераг расстоянием
-            const Vertex& v = pair.first;
-            double distance = pair.second;
+        // Многократное ослабление рёбер
+        for (size_t i = 1; i < n; ++i) {
+            bool changed = false;
+            for (size_t u = 0; u < n; ++u) {
+                if (distance[u] == unreachable()) // из недостижимой вершины ослаблять нечего
+                    continue;
+                for (size_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k) {
+                    size_t v = g.targets[k];
+                    if (distance[u] + g.weights[k] < distance[v]) { // если можем улучшить текущее расстояние до вершины v через вершину u
+                        distance[v] = distance[u] + g.weights[k];
+                        via[v] = k;
+                        parent[v] = u;
+                        changed = true;
+                    }
+                }
+            }
+            if (!changed)
+                break;
+        }
+
+        // Проверка на наличие отрицательных циклов
+        for (size_t u = 0; u < n; ++u) {
+            if (distance[u] == unreachable())
+                continue;
+            for (size_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k) {
+                if (distance[u] + g.weights[k] < distance[g.targets[k]]) // еслим можем улучшить расстояние до v через u значит есть отриц. цикл
+                    throw std::runtime_error("Граф содержит отрицательный цикл");
+            }
+        }
+    }
 
-            if (distance > max_avg_distance) {
-                max_avg_distance = distance;
-                furthest_hospital = v;
+    // по одному поиску из каждого источника sources[slot], источники делятся между потоками;
+    // visit(slot, distance) получает расстояния до всех вершин по их номерам.
+    // при отрицательных рёбрах веса сначала перевзвешиваются по Джонсону: потенциалы h - расстояния
+    // от фиктивной вершины, соединённой со всеми нулевыми рёбрами, и вес w(u, v) + h[u] - h[v] неотрицателен,
+    // так что и тогда из каждого источника работает дейкстра
+    template<typename Visit>
+    void for_each_source(const Compact& g, const std::vector<size_t>& sources, Visit visit) const {
+        const size_t n = g.vertices.size();
+        std::vector<Distance> potential(n, Distance());
+        std::vector<Distance> weights;
+        if (_negative_edges > 0) {
+            std::vector<size_t> via(n, npos), parent(n, npos);
+            bellman_ford(g, potential, via, parent);
+            weights.resize(g.weights.size());
+            for (size_t u = 0; u < n; ++u) {
+                for (size_t k = g.offsets[u]; k < g.offsets[u + 1]; ++k) {
+                    // std::max гасит отрицательный ноль от округления при вещественных весах
+                    weights[k] = std::max(Distance(), g.weights[k] + potential[u] - potential[g.targets[k]]);
+                }
             }
         }
+        const std::vector<Distance>& reweighted = _negative_edges > 0 ? weights : g.weights;
 
-        return furthest_hospital;
+        struct Workspace {
+            std::vector<Distance> distance;
+            std::vector<size_t> via;
+            std::vector<size_t> parent;
+        };
+        std::vector<Workspace> workspaces(WorkStealingPool::instance().size());
+
+        parallel_for(sources.size(), sources_per_block, [&](size_t worker, size_t slot) {
+            const size_t source = sources[slot];
+            Workspace& w = workspaces[worker];
+            w.distance.assign(n, unreachable());
+            w.via.assign(n, npos);
+            w.parent.assign(n, npos);
+            w.distance[source] = Distance();
+            dijkstra(g, reweighted, source, npos, w.distance, w.via, w.parent);
+            if (_negative_edges > 0) { // возвращаемся от перевзвешенных расстояний к настоящим
+                for (size_t v = 0; v < n; ++v) {
+                    if (w.distance[v] != unreachable())
+                        w.distance[v] = w.distance[v] - potential[source] + potential[v];
+                }
+            }
+            visit(slot, w.distance);
+        });
     }
 
-private:
-    // хранение вершин
-    std::unordered_set<Vertex> _vertices;
-    // хранение рёбер
-    std::unordered_map<Vertex, std::vector<Edge>> _edges;
+    // удалённость каждой вершины по поиску из каждого источника
+    std::vector<Remoteness> average_distances(const Compact& g) const {
+        const size_t n = g.vertices.size();
+        std::vector<size_t> sources(n);
+        for (size_t v = 0; v < n; ++v)
+            sources[v] = v;
+
+        std::vector<Remoteness> remoteness(n);
+        for_each_source(g, sources, [&](size_t source, const std::vector<Distance>& distance) {
+            double total_distance = 0.0;
+            size_t reachable = 0;
+            for (size_t v = 0; v < n; ++v) {
+                if (v == source) // убираем текующую вершину из рассмотрения
+                    continue;
+                if (distance[v] == unreachable()) {
+                    ++remoteness[source].unreachable;
+                    continue;
+                }
+                total_distance += static_cast<double>(distance[v]);
+                ++reachable;
+            }
+            if (reachable > 0)
+                remoteness[source].average = total_distance / reachable;
+        });
+        return remoteness;
+    }
+
+    // удалённость каждой вершины по готовой матрице расстояний; строки матрицы совпадают с номерами compact()
+    static std::vector<Remoteness> average_distances(const DistanceMatrix& m) {
+        const size_t n = m.order();
+        std::vector<Remoteness> remoteness(n);
+        for (size_t source = 0; source < n; ++source) {
+            double total_distance = 0.0;
+            size_t reachable = 0;
+            for (size_t v = 0; v < n; ++v) {
+                if (v == source)
+                    continue;
+                Distance value = m.cell(source, v);
+                if (!(value < dense_infinity())) {
+                    ++remoteness[source].unreachable;
+                    continue;
+                }
+                total_distance += static_cast<double>(value);
+                ++reachable;
+            }
+            if (reachable > 0)
+                remoteness[source].average = total_distance / reachable;
+        }
+        return remoteness;
+    }
 
     // получение всех вершин
     std::unordered_set<Vertex> vertices() const {
@@ -252,8 +914,124 @@ private:
     }
 };
 
-int main() {
+template<typename Func>
+double measure_ms(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// случайный ориентированный граф с неотрицательными весами
+Graph<int> random_graph(int vertex_count, int edge_count, std::mt19937& rng) {
+    Graph<int> graph;
+    for (int v = 0; v < vertex_count; ++v)
+        graph.add_vertex(v);
+    std::uniform_int_distribution<int> pick(0, vertex_count - 1);
+    std::uniform_real_distribution<double> weight(1.0, 100.0);
+    for (int i = 0; i < edge_count; ++i)
+        graph.add_edge(pick(rng), pick(rng), weight(rng));
+    return graph;
+}
+
+// точечные запросы пути на графе из 10^6 рёбер: дейкстра и беллман - форд
+void benchmark_shortest_path() {
+    const int vertex_count = 100000;
+    const int edge_count = 1000000;
+    const int query_count = 100;
+    std::mt19937 rng(42);
+    Graph<int> graph = random_graph(vertex_count, edge_count, rng);
+    std::uniform_int_distribution<int> pick(0, vertex_count - 1);
+
+    std::vector<std::pair<int, int>> queries;
+    for (int i = 0; i < query_count; ++i)
+        queries.push_back({ pick(rng), pick(rng) });
+
+    graph.shortest_path(0, 0); // сжатое представление строится один раз до замеров
+    size_t edges_found = 0;
+    double dijkstra_time = measure_ms([&]() {
+        for (const auto& q : queries)
+            edges_found += graph.shortest_path(q.first, q.second).size();
+    });
+
+    // одно отрицательное ребро в тупиковую вершину переключает граф на беллмана - форда
+    graph.add_vertex(vertex_count);
+    graph.add_edge(0, vertex_count, -1.0);
+    graph.shortest_path(0, 0);
+    size_t edges_found_bf = 0;
+    double bellman_ford_time = measure_ms([&]() {
+        edges_found_bf += graph.shortest_path(queries[0].first, queries[0].second).size();
+    });
+
+    std::cout << "shortest_path, " << vertex_count << " вершин, " << edge_count << " рёбер" << std::endl;
+    std::cout << "  дейкстра:       " << dijkstra_time / query_count << " мс на запрос (рёбер в путях: " << edges_found << ")" << std::endl;
+    std::cout << "  беллман - форд: " << bellman_ford_time << " мс на запрос (рёбер в пути: " << edges_found_bf << ")" << std::endl;
+}
+
+// самый удалённый травмпункт: попарные запросы shortest_path против одного поиска из каждой вершины
+void benchmark_furthest_hospital() {
+    const int sizes[] = { 300, 3000 };
+    std::mt19937 rng(7);
+    for (int vertex_count : sizes) {
+        Graph<int> graph = random_graph(vertex_count, vertex_count * 10, rng);
+        int furthest = 0;
+        double sssp_time = measure_ms([&]() {
+            furthest = graph.find_furthest_hospital();
+        });
+        std::cout << "find_furthest_hospital, " << vertex_count << " вершин, " << vertex_count * 10 << " рёбер" << std::endl;
+        std::cout << "  поиск из каждой вершины: " << sssp_time << " мс (вершина " << furthest << ")" << std::endl;
+        if (vertex_count > 300) // попарный перебор на больших графах слишком долгий
+            continue;
+
+        // прежняя схема: путь для каждой упорядоченной пары, длина - сумма рёбер пути
+        double pairwise_time = measure_ms([&]() {
+            double max_avg_distance = -1.0;
+            for (int v = 0; v < vertex_count; ++v) {
+                double total_distance = 0.0;
+                for (int u = 0; u < vertex_count; ++u) {
+                    if (u == v)
+                        continue;
+                    for (const auto& edge : graph.shortest_path(v, u))
+                        total_distance += edge.distance;
+                }
+                if (total_distance / (vertex_count - 1) > max_avg_distance) {
+                    max_avg_distance = total_distance / (vertex_count - 1);
+                    furthest = v;
+                }
+            }
+        });
+        std::cout << "  попарные запросы:        " << pairwise_time << " мс (вершина " << furthest << ")" << std::endl;
+    }
+}
+
+// плотные графы: матрица флойда - уоршелла против поиска из каждой вершины при разной доле рёбер
+void benchmark_all_pairs() {
+    const int vertex_count = 1000;
+    const int density_divisors[] = { 64, 16, 4, 1 };
+    std::mt19937 rng(11);
+    for (int divisor : density_divisors) {
+        const int edge_count = vertex_count * vertex_count / divisor;
+        Graph<int> graph = random_graph(vertex_count, edge_count, rng);
+        double matrix_time = measure_ms([&]() {
+            graph.all_pairs();
+        });
+        double furthest_time = measure_ms([&]() {
+            graph.find_furthest_hospital();
+        });
+        std::cout << "all_pairs, " << vertex_count << " вершин, " << edge_count << " рёбер (V^2 / " << divisor << ")" << std::endl;
+        std::cout << "  матрица:                " << matrix_time << " мс" << std::endl;
+        std::cout << "  find_furthest_hospital: " << furthest_time << " мс" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "Rus");
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        benchmark_shortest_path();
+        benchmark_furthest_hospital();
+        benchmark_all_pairs();
+        return 0;
+    }
     Graph<int> graph;
 
     graph.add_vertex(1);
@@ -1,399 +1,2805 @@
 ﻿#include <iostream>
-#include <queue>
 #include <initializer_list>
 #include <chrono>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <random>
+#include <set>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <utility>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LAB1_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <span>
+#include <bit>
+#include <type_traits>
+#include <cstring>
+#include <cstdio>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 using namespace std::chrono;
 
 
+inline void prefetch(const void* address)
+{
+#if defined(LAB1_SSE2)
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(address);
+#endif
+}
+
+
+// a Set node; children are 32-bit indices into the NodeArena, 0 is the null link.
+// While a node is reachable from more than one Set it is immutable, refs counts
+// the parents and Set roots that hold it
 struct Node
 {
 	int key;
-	Node* left;
-	Node* right;
+	int height; // AVL height of the subtree, leaf = 1
+	uint32_t count; // number of keys in the subtree
+	mutable std::atomic<uint32_t> refs; // bookkeeping, changes while the node is shared
+	uint32_t left;
+	uint32_t right;
+
+	Node() : key(0), height(0), count(0), refs(0), left(0), right(0) {}
+};
+
+
+// node storage shared by a Set and all of its copies: nodes live in chunks that
+// never move, found through a directory of chunk pointers. A full directory is
+// replaced by a bigger copy rather than grown in place, copies on other threads
+// may still be reading the old one, so it is kept until the arena goes away.
+// Slot 0 is a null sentinel of height 0 and count 0, released nodes go on a
+// free list. The lock serializes allocations and frees of the copies
+class NodeArena
+{
+public:
+	static const uint32_t null = 0;
+	static constexpr int chunk_bits = 10;
+	static constexpr size_t chunk_size = size_t(1) << chunk_bits;
+
+private:
+	std::mutex _lock;
+	std::atomic<Node**> _directory;
+	std::vector<std::unique_ptr<Node*[]>> _directories; // the current one last
+	size_t _directory_capacity;
+	std::vector<std::unique_ptr<Node[]>> _chunks;
+	uint32_t _next; // first index never handed out
+	uint32_t _free; // free list, linked through Node::left
+
+	// makes room for n more indices past _next; throws once 32 bits run out
+	void grow(size_t n)
+	{
+		if (n > UINT32_MAX - _next) throw std::length_error("NodeArena: more than 2^32 - 1 nodes");
+		while (_chunks.size() * chunk_size < _next + n)
+		{
+			std::unique_ptr<Node[]> chunk(new Node[chunk_size]);
+			size_t count = _chunks.size();
+			if (count == _directory_capacity)
+			{
+				size_t capacity = std::max<size_t>(16, 2 * count);
+				std::unique_ptr<Node*[]> directory(new Node*[capacity]);
+				if (count) std::copy(_directories.back().get(), _directories.back().get() + count, directory.get());
+				directory[count] = chunk.get();
+				_directories.push_back(std::move(directory));
+				_directory.store(_directories.back().get(), std::memory_order_release);
+				_directory_capacity = capacity;
+			}
+			else
+			{
+				_directories.back()[count] = chunk.get();
+			}
+			_chunks.push_back(std::move(chunk));
+		}
+	}
+
+	// unlinks the nodes that lose their last reference onto [head, tail]
+	void collect(uint32_t index, uint32_t& head, uint32_t& tail)
+	{
+		if (!index) return;
+		Node& n = (*this)[index];
+		if (n.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+		collect(n.left, head, tail);
+		collect(n.right, head, tail);
+		n.left = head;
+		head = index;
+		if (!tail) tail = index;
+	}
+
+public:
+	NodeArena() : _directory(nullptr), _directory_capacity(0), _next(1), _free(null) {}
+	NodeArena(const NodeArena&) = delete;
+	NodeArena& operator=(const NodeArena&) = delete;
+
+	// the current chunk directory: it lists every chunk allocated so far and
+	// stays readable for as long as the arena lives
+	Node* const* directory() const
+	{
+		return _directory.load(std::memory_order_acquire);
+	}
+
+	static Node& at(Node* const* directory, uint32_t index)
+	{
+		return directory[index >> chunk_bits][index & (chunk_size - 1)];
+	}
+
+	Node& operator[](uint32_t index) const
+	{
+		return at(directory(), index);
+	}
+
+	// a leaf holding key, with one reference
+	uint32_t allocate(int key)
+	{
+		uint32_t index;
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			if (_free)
+			{
+				index = _free;
+				_free = (*this)[index].left;
+			}
+			else
+			{
+				grow(1);
+				index = _next++;
+			}
+		}
+		Node& node = (*this)[index];
+		node.key = key;
+		node.height = 1;
+		node.count = 1;
+		node.refs.store(1, std::memory_order_relaxed);
+		node.left = node.right = null;
+		return index;
+	}
+
+	// n nodes with consecutive indices under a single lock, for bulk builds that
+	// fill in every field themselves; returns the first index
+	uint32_t allocate_run(size_t n)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		grow(n);
+		uint32_t first = _next;
+		_next += static_cast<uint32_t>(n);
+		return first;
+	}
+
+	// returns the unused n nodes at the end of a run
+	void give_back(uint32_t first, size_t n)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		if (n && first + n == _next)
+		{
+			_next = first;
+			return;
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			uint32_t index = first + static_cast<uint32_t>(i);
+			(*this)[index].left = _free;
+			_free = index;
+		}
+	}
+
+	// the node goes back on the free list as is, its children are not touched
+	void recycle(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		(*this)[index].left = _free;
+		_free = index;
+	}
+
+	void retain(uint32_t index) const
+	{
+		if (index) (*this)[index].refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// drops one reference; a node that loses its last one is freed and drops the
+	// references it held on its children, so only the unshared part is walked
+	void release(uint32_t index)
+	{
+		uint32_t head = null;
+		uint32_t tail = null;
+		collect(index, head, tail);
+		if (!head) return;
+		std::lock_guard<std::mutex> lock(_lock);
+		(*this)[tail].left = _free;
+		_free = head;
+	}
+
+	size_t growths() const { return _chunks.size(); }
+	size_t bytes() const { return _chunks.size() * chunk_size * sizeof(Node) + _directory_capacity * sizeof(Node*); }
+};
+
+
+// sorts and dedupes keys; big inputs are sorted in chunks on all cores and merged pairwise
+void sort_unique(std::vector<int>& keys)
+{
+	const size_t parallel_threshold = 1 << 16;
+	if (!std::is_sorted(keys.begin(), keys.end()))
+	{
+		size_t chunks = std::max(1u, std::thread::hardware_concurrency());
+		if (keys.size() < parallel_threshold || chunks == 1)
+		{
+			std::sort(keys.begin(), keys.end());
+		}
+		else
+		{
+			std::vector<size_t> bounds(chunks + 1);
+			for (size_t i = 0; i <= chunks; ++i) bounds[i] = keys.size() * i / chunks;
+
+			std::vector<std::thread> workers;
+			for (size_t i = 0; i < chunks; ++i)
+			{
+				workers.emplace_back([&keys, &bounds, i]() {
+					std::sort(keys.begin() + bounds[i], keys.begin() + bounds[i + 1]);
+					});
+			}
+			for (std::thread& worker : workers) worker.join();
+
+			for (size_t width = 1; width < chunks; width *= 2)
+			{
+				workers.clear();
+				for (size_t i = 0; i + width < chunks; i += 2 * width)
+				{
+					size_t lo = bounds[i], mid = bounds[i + width], hi = bounds[std::min(i + 2 * width, chunks)];
+					workers.emplace_back([&keys, lo, mid, hi]() {
+						std::inplace_merge(keys.begin() + lo, keys.begin() + mid, keys.begin() + hi);
+						});
+				}
+				for (std::thread& worker : workers) worker.join();
+			}
+		}
+	}
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+
+// path-copying AVL updates over immutable nodes, shared by Set and ConcurrentSet:
+// no existing node is written, the nodes on the search path are rebuilt through
+// tree.make(key, left, right) and every node that was replaced is listed in old.
+// Ref is how the tree links its nodes, tree.node(ref) the node it names
+template<typename Tree, typename Ref>
+class PathCopy
+{
+	Tree& _tree;
+	std::vector<Ref>& _old;
+
+	int height(Ref node) const
+	{
+		return node ? _tree.node(node).height : 0;
+	}
+
+	// new node over left and right whose heights differ by at most 2, rotating by copy
+	Ref join(int key, Ref left, Ref right)
+	{
+		int hl = height(left), hr = height(right);
+		if (hl > hr + 1)
+		{
+			_old.push_back(left);
+			const auto& l = _tree.node(left);
+			if (height(l.left) >= height(l.right))
+				return _tree.make(l.key, l.left, _tree.make(key, l.right, right));
+			const auto& lr = _tree.node(l.right);
+			_old.push_back(l.right);
+			return _tree.make(lr.key, _tree.make(l.key, l.left, lr.left), _tree.make(key, lr.right, right));
+		}
+		if (hr > hl + 1)
+		{
+			_old.push_back(right);
+			const auto& r = _tree.node(right);
+			if (height(r.right) >= height(r.left))
+				return _tree.make(r.key, _tree.make(key, left, r.left), r.right);
+			const auto& rl = _tree.node(r.left);
+			_old.push_back(r.left);
+			return _tree.make(rl.key, _tree.make(key, left, rl.left), _tree.make(r.key, rl.right, r.right));
+		}
+		return _tree.make(key, left, right);
+	}
+
+	Ref extract_min(Ref node, int& min)
+	{
+		_old.push_back(node);
+		const auto& n = _tree.node(node);
+		if (!n.left)
+		{
+			min = n.key;
+			return n.right;
+		}
+		Ref left = extract_min(n.left, min);
+		return join(n.key, left, n.right);
+	}
+
+public:
+	PathCopy(Tree& tree, std::vector<Ref>& old) : _tree(tree), _old(old) {}
+
+	// returns node itself when key is already there
+	Ref insert(Ref node, int key)
+	{
+		if (!node) return _tree.make(key, Ref(), Ref());
+		const auto& n = _tree.node(node);
+		if (key == n.key) return node;
+		if (key < n.key)
+		{
+			Ref left = insert(n.left, key);
+			if (left == n.left) return node;
+			_old.push_back(node);
+			return join(n.key, left, n.right);
+		}
+		Ref right = insert(n.right, key);
+		if (right == n.right) return node;
+		_old.push_back(node);
+		return join(n.key, n.left, right);
+	}
+
+	// returns node itself, with old left empty, when key is not there
+	Ref erase(Ref node, int key)
+	{
+		if (!node) return Ref();
+		const auto& n = _tree.node(node);
+		if (key < n.key)
+		{
+			Ref left = erase(n.left, key);
+			if (left == n.left) return node;
+			_old.push_back(node);
+			return join(n.key, left, n.right);
+		}
+		if (key > n.key)
+		{
+			Ref right = erase(n.right, key);
+			if (right == n.right) return node;
+			_old.push_back(node);
+			return join(n.key, n.left, right);
+		}
+		_old.push_back(node);
+		if (!n.left) return n.right;
+		if (!n.right) return n.left;
+		int min;
+		Ref right = extract_min(n.right, min);
+		return join(min, n.left, right);
+	}
+};
+
+
+// persistent AVL set: a copy shares the whole tree in O(1) and holds a reference
+// on its root. An update writes in place while no copy shares the nodes and
+// otherwise copies only the O(log n) nodes on its path, leaving the copies intact
+class Set
+{
+	template<typename, typename> friend class PathCopy;
+
+	std::shared_ptr<NodeArena> _nodes; // shared with every copy, null until the first node
+	Node* const* _chunks; // the arena directory as of this set's last allocation, it covers every node the set reaches
+	uint32_t _root;
+	size_t _size;
+
+	// a node is written in place only while no copy shares the arena, every
+	// node then has exactly one holder
+	Node& node(uint32_t index) const
+	{
+		return NodeArena::at(_chunks, index);
+	}
+
+	// a leaf holding key; the leaf may sit in a chunk new to _chunks
+	uint32_t allocate(int key)
+	{
+		uint32_t index = _nodes->allocate(key);
+		_chunks = _nodes->directory();
+		return index;
+	}
+
+	// true while a copy shares the nodes
+	bool shared() const
+	{
+		if (_nodes.use_count() > 1) return true;
+		// a copy just destroyed on another thread is done reading the nodes
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return false;
+	}
+
+	NodeArena& arena_for_write()
+	{
+		if (!_nodes) _nodes = std::make_shared<NodeArena>();
+		return *_nodes;
+	}
+
+	void _print(uint32_t root) const
+	{
+		if (!root) return;
+		_print(node(root).left);
+		std::cout << node(root).key << " ";
+		_print(node(root).right);
+	}
+
+	template<typename Func>
+	void _for_each(uint32_t root, Func& func) const
+	{
+		if (!root) return;
+		_for_each(node(root).left, func);
+		func(node(root).key);
+		_for_each(node(root).right, func);
+	}
+
+	// keys < key, or <= key when inclusive
+	size_t _count_less(int key, bool inclusive) const
+	{
+		size_t result = 0;
+		uint32_t tmp = _root;
+		while (tmp)
+		{
+			const Node& n = node(tmp);
+			if (n.key < key || (inclusive && n.key == key))
+			{
+				result += count(n.left) + 1;
+				tmp = n.right;
+			}
+			else
+			{
+				tmp = n.left;
+			}
+		}
+		return result;
+	}
+
+	// perfectly balanced subtree over the next count nodes of list, a chain of
+	// ascending keys linked through right; heights are set bottom-up
+	uint32_t _link(uint32_t& list, size_t count)
+	{
+		if (count == 0) return NodeArena::null;
+		uint32_t left = _link(list, count / 2);
+		uint32_t index = list;
+		Node& n = node(index);
+		list = n.right;
+		n.left = left;
+		n.right = _link(list, count - count / 2 - 1);
+		update(n);
+		return index;
+	}
+
+	// replaces the contents with the keys produce(emit) emits in strictly
+	// ascending order, in one O(k) pass: each key goes into a new node chained
+	// to the previous one, the chain is then linked into a balanced tree.
+	// The nodes come from the fresh arena in runs, the first one of expected
+	// nodes and, past the estimate, each as long as the chain so far, so the
+	// arena lock is taken once per run. If anything throws the set is left empty
+	template<typename Producer>
+	void _assign_ascending(size_t expected, Producer produce)
+	{
+		clear();
+		try
+		{
+			NodeArena& arena = arena_for_write();
+			uint32_t run = NodeArena::null;
+			size_t run_left = 0;
+			size_t size = 0;
+			uint32_t list = NodeArena::null;
+			uint32_t* tail = &list;
+			produce([&](int key) {
+				if (run_left == 0)
+				{
+					run_left = size < expected ? expected - size : std::max<size_t>(size, 1);
+					run = arena.allocate_run(run_left);
+					_chunks = arena.directory();
+				}
+				Node& n = node(run);
+				n.key = key;
+				n.refs.store(1, std::memory_order_relaxed);
+				n.left = n.right = NodeArena::null;
+				*tail = run++;
+				tail = &n.right;
+				--run_left;
+				++size;
+				});
+			if (run_left) arena.give_back(run, run_left);
+			_root = _link(list, size);
+			_size = size;
+		}
+		catch (...)
+		{
+			_nodes.reset();
+			_root = NodeArena::null;
+			_size = 0;
+			throw;
+		}
+		if (!_root) _nodes.reset();
+	}
+
+	// the null sentinel gives 0 for both
+	int height(uint32_t index) const
+	{
+		return node(index).height;
+	}
+
+	uint32_t count(uint32_t index) const
+	{
+		return node(index).count;
+	}
+
+	// recomputes height and count from the children
+	void update(Node& n) const
+	{
+		const Node& left = node(n.left);
+		const Node& right = node(n.right);
+		n.height = 1 + std::max(left.height, right.height);
+		n.count = 1 + left.count + right.count;
+	}
+
+	uint32_t rotate_right(uint32_t index)
+	{
+		Node& n = node(index);
+		uint32_t tmp = n.left;
+		Node& t = node(tmp);
+		n.left = t.right;
+		t.right = index;
+		update(n);
+		update(t);
+		return tmp;
+	}
+
+	uint32_t rotate_left(uint32_t index)
+	{
+		Node& n = node(index);
+		uint32_t tmp = n.right;
+		Node& t = node(tmp);
+		n.right = t.left;
+		t.left = index;
+		update(n);
+		update(t);
+		return tmp;
+	}
+
+	// restores |h(left) - h(right)| <= 1 after one insert or erase below index
+	uint32_t balance(uint32_t index)
+	{
+		Node& n = node(index);
+		update(n);
+		int factor = height(n.left) - height(n.right);
+		if (factor > 1)
+		{
+			if (height(node(n.left).left) < height(node(n.left).right))
+				n.left = rotate_left(n.left);
+			return rotate_right(index);
+		}
+		if (factor < -1)
+		{
+			if (height(node(n.right).right) < height(node(n.right).left))
+				n.right = rotate_right(n.right);
+			return rotate_left(index);
+		}
+		return index;
+	}
+
+	// in-place insert for an unshared tree, returns the new subtree root. Above
+	// the first level whose height did not change only the counts move, so the
+	// siblings off the path are read only while the path is being rebalanced
+	uint32_t _insert(uint32_t index, const int key, bool& inserted)
+	{
+		if (!index) {
+			inserted = true;
+			return allocate(key);
+		}
+		Node& n = node(index);
+		uint32_t child;
+		if (key < n.key) {
+			child = n.left = _insert(n.left, key, inserted);
+		}
+		else if (key > n.key) {
+			child = n.right = _insert(n.right, key, inserted);
+		}
+		else {
+			return index;
+		}
+		if (!inserted) return index;
+		if (node(child).height < n.height) {
+			++n.count;
+			return index;
+		}
+		return balance(index);
+	}
+
+	// unlinks the minimum of the subtree into min, returns the new subtree root
+	uint32_t _extract_min(uint32_t index, uint32_t& min)
+	{
+		Node& n = node(index);
+		if (!n.left) {
+			min = index;
+			return n.right;
+		}
+		n.left = _extract_min(n.left, min);
+		return balance(index);
+	}
+
+	// in-place erase for an unshared tree
+	uint32_t _erase(uint32_t index, const int key, bool& erased)
+	{
+		if (!index) {
+			return index;
+		}
+		Node& n = node(index);
+		if (key < n.key) {
+			n.left = _erase(n.left, key, erased);
+		}
+		else if (key > n.key) {
+			n.right = _erase(n.right, key, erased);
+		}
+		else {
+			erased = true;
+			uint32_t left = n.left;
+			uint32_t right = n.right;
+			_nodes->recycle(index);
+			if (!left) return right;
+			if (!right) return left;
+			uint32_t min_right;
+			right = _extract_min(right, min_right);
+			index = min_right;
+			node(index).left = left;
+			node(index).right = right;
+		}
+		return erased ? balance(index) : index;
+	}
+
+	// a node for a path-copying update: it holds a reference on both children
+	// and nobody holds one on it yet
+	uint32_t make(int key, uint32_t left, uint32_t right)
+	{
+		uint32_t index = allocate(key);
+		Node& n = node(index);
+		n.refs.store(0, std::memory_order_relaxed);
+		n.left = left;
+		n.right = right;
+		_nodes->retain(left);
+		_nodes->retain(right);
+		update(n);
+		return index;
+	}
+
+	// installs the result of a path-copying update. Nodes the update built and
+	// dropped again are held by nobody and are freed; letting go of the old root
+	// frees the replaced path unless a copy still holds it
+	void publish(uint32_t root, std::vector<uint32_t>& old)
+	{
+		_nodes->retain(root);
+		size_t transient = 0;
+		for (uint32_t index : old)
+		{
+			if (node(index).refs.load(std::memory_order_relaxed) == 0) old[transient++] = index;
+		}
+		for (size_t i = 0; i < transient; ++i)
+		{
+			node(old[i]).refs.store(1, std::memory_order_relaxed);
+			_nodes->release(old[i]);
+		}
+		_nodes->release(_root);
+		_root = root;
+	}
+
+	// result of a set operation: merge(emit) walks the inputs and emits the
+	// result keys in ascending order straight into the balanced build;
+	// expected, an estimate of the result size, sizes the first node run
+	template<typename Merge>
+	static Set _merged(size_t expected, Merge merge)
+	{
+		Set result;
+		result._assign_ascending(expected, merge);
+		return result;
+	}
+
+	friend bool operator==(const Set& first, const Set& second);
+	friend Set set_union(const Set& first, const Set& second);
+	friend Set intersection(const Set& first, const Set& second);
+	friend Set difference(const Set& first, const Set& second);
+
+public:
+	// in-order iterator, keeps the path from the root; any insert or erase invalidates it
+	class const_iterator
+	{
+		friend class Set;
+
+		// the path is kept inline, so iterators never allocate; an AVL tree of
+		// fewer than 2^32 nodes is at most 45 levels deep
+		struct Path
+		{
+			uint32_t nodes[48];
+			size_t depth = 0;
+
+			void push_back(uint32_t node) { nodes[depth++] = node; }
+			void pop_back() { --depth; }
+			uint32_t back() const { return nodes[depth - 1]; }
+			bool empty() const { return depth == 0; }
+			size_t size() const { return depth; }
+			void resize(size_t size) { depth = size; }
+		};
+
+		const Set* _set;
+		Path _path; // empty for end()
+
+		void descend(uint32_t node, bool to_left)
+		{
+			while (node)
+			{
+				_path.push_back(node);
+				node = to_left ? _set->node(node).left : _set->node(node).right;
+			}
+		}
+
+		const_iterator(const Set* set) : _set(set) {}
+
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef int value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const int* pointer;
+		typedef const int& reference;
+
+		const_iterator() : _set(nullptr) {}
+
+		reference operator*() const { return _set->node(_path.back()).key; }
+		pointer operator->() const { return &_set->node(_path.back()).key; }
+
+		const_iterator& operator++()
+		{
+			uint32_t right = _set->node(_path.back()).right;
+			if (right)
+			{
+				descend(right, true);
+				return *this;
+			}
+			uint32_t child = _path.back();
+			_path.pop_back();
+			while (!_path.empty() && _set->node(_path.back()).right == child)
+			{
+				child = _path.back();
+				_path.pop_back();
+			}
+			return *this;
+		}
+
+		const_iterator& operator--()
+		{
+			if (_path.empty())
+			{
+				descend(_set->_root, false);
+				return *this;
+			}
+			uint32_t left = _set->node(_path.back()).left;
+			if (left)
+			{
+				descend(left, false);
+				return *this;
+			}
+			uint32_t child = _path.back();
+			_path.pop_back();
+			while (!_path.empty() && _set->node(_path.back()).left == child)
+			{
+				child = _path.back();
+				_path.pop_back();
+			}
+			return *this;
+		}
+
+		const_iterator operator++(int) { const_iterator tmp(*this); ++*this; return tmp; }
+		const_iterator operator--(int) { const_iterator tmp(*this); --*this; return tmp; }
+
+		bool operator==(const const_iterator& other) const
+		{
+			if (_path.empty() || other._path.empty()) return _path.empty() == other._path.empty();
+			return _path.back() == other._path.back();
+		}
+		bool operator!=(const const_iterator& other) const { return !(*this == other); }
+	};
+	typedef const_iterator iterator;
+
+	Set() : _chunks(nullptr), _root(NodeArena::null), _size(0) {}
+
+	Set(std::initializer_list<int> list) : Set(list.begin(), list.end()) {}
+
+	// bulk construction: sort + dedupe, then a linear balanced build
+	template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+	Set(InputIt first, InputIt last) : _chunks(nullptr), _root(NodeArena::null), _size(0)
+	{
+		std::vector<int> keys(first, last);
+		sort_unique(keys);
+		assign_sorted(keys);
+	}
+
+	explicit Set(std::vector<int> keys) : _chunks(nullptr), _root(NodeArena::null), _size(0)
+	{
+		sort_unique(keys);
+		assign_sorted(keys);
+	}
+
+	// O(1): the copy shares the tree
+	Set(const Set& other) : _nodes(other._nodes), _chunks(other._chunks), _root(other._root), _size(other._size)
+	{
+		if (_nodes) _nodes->retain(_root);
+	}
+
+	Set(Set&& other) noexcept : _nodes(std::move(other._nodes)), _chunks(other._chunks), _root(other._root), _size(other._size)
+	{
+		other._root = NodeArena::null;
+		other._size = 0;
+	}
+
+	~Set()
+	{
+		if (shared()) _nodes->release(_root);
+	}
+
+	void print()
+	{
+		_print(_root);
+	}
+
+	bool insert(int key)
+	{
+		arena_for_write();
+		if (shared())
+		{
+			std::vector<uint32_t> old;
+			uint32_t root = PathCopy<Set, uint32_t>(*this, old).insert(_root, key);
+			if (root == _root) return false;
+			publish(root, old);
+		}
+		else
+		{
+			bool inserted = false;
+			_root = _insert(_root, key, inserted);
+			if (!inserted) return false;
+		}
+		++_size;
+		return true;
+	}
+
+	bool contains(int key) const
+	{
+		uint32_t tmp = _root;
+		while (tmp)
+		{
+			const Node& n = node(tmp);
+			if (n.key == key) return true;
+			tmp = key < n.key ? n.left : n.right;
+		}
+
+		return false;
+	}
+
+	// results[i] = contains(keys[i]); runs batch_group descents side by side and
+	// prefetches each next node, so their cache misses overlap instead of queuing.
+	// results must hold at least keys.size() entries
+	void contains_batch(std::span<const int> keys, std::span<bool> results) const
+	{
+		if (results.size() < keys.size()) throw std::length_error("Set::contains_batch: results is shorter than keys");
+		const size_t batch_group = 16;
+		uint32_t current[batch_group];
+		for (size_t base = 0; base < keys.size(); base += batch_group)
+		{
+			size_t count = std::min(batch_group, keys.size() - base);
+			for (size_t i = 0; i < count; ++i)
+			{
+				current[i] = _root;
+				results[base + i] = false;
+			}
+			if (_root) prefetch(&node(_root));
+
+			size_t active = count;
+			while (active)
+			{
+				active = 0;
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (!current[i]) continue;
+					const Node& n = node(current[i]);
+					int key = keys[base + i];
+					if (n.key == key)
+					{
+						results[base + i] = true;
+						current[i] = NodeArena::null;
+						continue;
+					}
+					current[i] = key < n.key ? n.left : n.right;
+					if (current[i])
+					{
+						prefetch(&node(current[i]));
+						++active;
+					}
+				}
+			}
+		}
+	}
+
+	// inserts all keys, returns how many were new; a batch that is large
+	// against the set is merged and rebuilt, a small one is inserted in key order
+	size_t insert_batch(std::span<const int> keys)
+	{
+		std::vector<int> sorted(keys.begin(), keys.end());
+		sort_unique(sorted);
+		size_t before = _size;
+		if (sorted.size() * 4 >= _size)
+		{
+			std::vector<int> current = this->keys(), merged;
+			merged.reserve(current.size() + sorted.size());
+			std::set_union(current.begin(), current.end(), sorted.begin(), sorted.end(), std::back_inserter(merged));
+			assign_sorted(merged);
+		}
+		else
+		{
+			for (int key : sorted) insert(key);
+		}
+		return _size - before;
+	}
+
+	bool erase(int key)
+	{
+		if (!_root) return false;
+		if (shared())
+		{
+			std::vector<uint32_t> old;
+			uint32_t root = PathCopy<Set, uint32_t>(*this, old).erase(_root, key);
+			if (old.empty()) return false;
+			publish(root, old);
+		}
+		else
+		{
+			bool erased = false;
+			_root = _erase(_root, key, erased);
+			if (!erased) return false;
+		}
+		--_size;
+		return true;
+	}
+
+	// an unshared arena is dropped at once, no per-node walk; copies keep their nodes
+	void clear()
+	{
+		if (shared()) _nodes->release(_root);
+		_nodes.reset();
+		_root = NodeArena::null;
+		_size = 0;
+	}
+
+	// replaces the contents with strictly ascending keys in O(n)
+	void assign_sorted(const std::vector<int>& keys)
+	{
+		_assign_ascending(keys.size(), [&keys](auto emit) {
+			for (int key : keys) emit(key);
+			});
+	}
+
+	bool empty() const
+	{
+		return !_root;
+	}
+
+	size_t size() const
+	{
+		return _size;
+	}
+
+	// all keys in ascending order
+	std::vector<int> keys() const
+	{
+		std::vector<int> result;
+		result.reserve(_size);
+		for_each([&](int key) { result.push_back(key); });
+		return result;
+	}
+
+private:
+	// first key > key when strict, first key >= key otherwise
+	const_iterator _bound(int key, bool strict) const
+	{
+		const_iterator it(this);
+		size_t keep = 0;
+		uint32_t tmp = _root;
+		while (tmp)
+		{
+			it._path.push_back(tmp);
+			const Node& n = node(tmp);
+			if (n.key > key || (!strict && n.key == key))
+			{
+				keep = it._path.size();
+				tmp = n.left;
+			}
+			else
+			{
+				tmp = n.right;
+			}
+		}
+		it._path.resize(keep);
+		return it;
+	}
+
+public:
+	const_iterator begin() const
+	{
+		const_iterator it(this);
+		it.descend(_root, true);
+		return it;
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(this);
+	}
+
+	// first key >= key
+	const_iterator lower_bound(int key) const
+	{
+		return _bound(key, false);
+	}
+
+	// first key > key
+	const_iterator upper_bound(int key) const
+	{
+		return _bound(key, true);
+	}
+
+	// k-th smallest key, counting from 0
+	int select(size_t k) const
+	{
+		if (k >= _size) throw std::out_of_range("Set::select: index out of range");
+		uint32_t tmp = _root;
+		while (true)
+		{
+			const Node& n = node(tmp);
+			size_t left_count = count(n.left);
+			if (k == left_count) return n.key;
+			if (k < left_count)
+			{
+				tmp = n.left;
+			}
+			else
+			{
+				k -= left_count + 1;
+				tmp = n.right;
+			}
+		}
+	}
+
+	// number of keys less than key
+	size_t rank(int key) const
+	{
+		return _count_less(key, false);
+	}
+
+	// number of keys in [from, to]
+	size_t count_range(int from, int to) const
+	{
+		if (to < from) return 0;
+		return _count_less(to, true) - _count_less(from, false);
+	}
+
+	// calls func(key) for every key in ascending order
+	template<typename Func>
+	void for_each(Func func) const
+	{
+		_for_each(_root, func);
+	}
+
+	// node storage, shared with the copies of this set
+	const NodeArena& arena() const
+	{
+		static const NodeArena none;
+		return _nodes ? *_nodes : none;
+	}
+
+	Set& operator=(Set&& set) noexcept
+	{
+		if (this != &set)
+		{
+			clear();
+			_nodes = std::move(set._nodes);
+			_chunks = set._chunks;
+			_root = set._root;
+			_size = set._size;
+			set._root = NodeArena::null;
+			set._size = 0;
+		}
+		return *this;
+	}
+
+	// O(1), shares the tree
+	Set& operator=(const Set& set)
+	{
+		if (this != &set) *this = Set(set);
+		return *this;
+	}
+};
+
+
+// set algebra merges the in-order iterators of both sets, O(n + m) plus an O(k)
+// balanced build of the result; nothing is copied out of the inputs
+
+bool operator==(const Set& first, const Set& second)
+{
+	if (first.size() != second.size()) return false;
+	if (first._nodes == second._nodes && first._root == second._root) return true; // copies of one another
+	return std::equal(first.begin(), first.end(), second.begin());
+}
+
+
+Set set_union(const Set& first, const Set& second)
+{
+	if (first.empty()) return second;
+	if (second.empty()) return first;
+	return Set::_merged(std::max(first.size(), second.size()), [&](auto emit) {
+		Set::const_iterator a = first.begin(), b = second.begin(), a_end = first.end(), b_end = second.end();
+		while (a != a_end && b != b_end)
+		{
+			int x = *a, y = *b;
+			if (x < y) { emit(x); ++a; }
+			else if (y < x) { emit(y); ++b; }
+			else { emit(x); ++a; ++b; }
+		}
+		for (; a != a_end; ++a) emit(*a);
+		for (; b != b_end; ++b) emit(*b);
+		});
+}
+
+
+Set intersection(const Set& first, const Set& second)
+{
+	if (first.empty() || second.empty()) return Set();
+	return Set::_merged(std::min(first.size(), second.size()), [&](auto emit) {
+		Set::const_iterator a = first.begin(), b = second.begin(), a_end = first.end(), b_end = second.end();
+		while (a != a_end && b != b_end)
+		{
+			int x = *a, y = *b;
+			if (x < y) ++a;
+			else if (y < x) ++b;
+			else { emit(x); ++a; ++b; }
+		}
+		});
+}
+
+
+Set difference(const Set& first, const Set& second)
+{
+	if (first.empty()) return Set();
+	if (second.empty()) return first;
+	return Set::_merged(first.size(), [&](auto emit) {
+		Set::const_iterator a = first.begin(), b = second.begin(), a_end = first.end(), b_end = second.end();
+		while (a != a_end && b != b_end)
+		{
+			int x = *a, y = *b;
+			if (x < y) { emit(x); ++a; }
+			else if (y < x) ++b;
+			else { ++a; ++b; }
+		}
+		for (; a != a_end; ++a) emit(*a);
+		});
+}
+
+
+// read-optimized set: keys frozen into an implicit B-tree array (16 keys per node,
+// node k has children k * 17 + 1 ... k * 17 + 17), no pointers to chase.
+// insert/erase edit the sorted key array and the tree is rebuilt on the next lookup;
+// concurrent const lookups are safe, the first one to find the tree stale rebuilds it.
+class FlatSet
+{
+	static const size_t B = 16;
+
+	// dirty is cleared only after the rebuild, so a reader that loads it clear
+	// sees the finished tree; the lock lets one reader rebuild while the others wait
+	struct Staleness
+	{
+		std::mutex lock;
+		std::atomic<bool> dirty;
+
+		explicit Staleness(bool dirty) : dirty(dirty) {}
+		Staleness(const Staleness& other) : dirty(other.dirty.load()) {}
+
+		Staleness& operator=(const Staleness& other)
+		{
+			dirty.store(other.dirty.load());
+			return *this;
+		}
+	};
+
+	std::vector<int> _keys; // sorted, unique
+	mutable std::vector<int> _tree; // nblocks * B keys, tail padded with INT_MAX
+	mutable size_t _nblocks;
+	mutable Staleness _stale;
+
+	static size_t child(size_t k, size_t i)
+	{
+		return k * (B + 1) + i + 1;
+	}
+
+	// number of keys in the node that are less than key
+	static size_t rank(const int* node, int key)
+	{
+#ifdef LAB1_SSE2
+		__m128i x = _mm_set1_epi32(key);
+		__m128i c0 = _mm_cmpgt_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node)));
+		__m128i c1 = _mm_cmpgt_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node + 4)));
+		__m128i c2 = _mm_cmpgt_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node + 8)));
+		__m128i c3 = _mm_cmpgt_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(node + 12)));
+		__m128i sum = _mm_add_epi32(_mm_add_epi32(c0, c1), _mm_add_epi32(c2, c3)); // each match is -1
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return static_cast<size_t>(-_mm_cvtsi128_si32(sum));
+#else
+		size_t count = 0;
+		for (size_t i = 0; i < B; ++i) count += node[i] < key;
+		return count;
+#endif
+	}
+
+	void _build(size_t k, size_t& t) const
+	{
+		if (k >= _nblocks) return;
+		for (size_t i = 0; i < B; ++i)
+		{
+			_build(child(k, i), t);
+			if (t < _keys.size()) _tree[k * B + i] = _keys[t++];
+		}
+		_build(child(k, B), t);
+	}
+
+	void rebuild() const
+	{
+		if (!_stale.dirty.load(std::memory_order_acquire)) return;
+		std::lock_guard<std::mutex> lock(_stale.lock);
+		if (!_stale.dirty.load(std::memory_order_relaxed)) return;
+		_nblocks = (_keys.size() + B - 1) / B;
+		_tree.assign(_nblocks * B, INT_MAX);
+		size_t t = 0;
+		_build(0, t);
+		_stale.dirty.store(false, std::memory_order_release);
+	}
+
+public:
+	FlatSet() : _nblocks(0), _stale(false) {}
+
+	explicit FlatSet(std::vector<int> keys) : _keys(std::move(keys)), _nblocks(0), _stale(true)
+	{
+		sort_unique(_keys);
+	}
+
+	explicit FlatSet(const Set& set) : _keys(set.keys()), _nblocks(0), _stale(true) {}
+
+	bool contains(int key) const
+	{
+		rebuild();
+		if (key == INT_MAX) return std::binary_search(_keys.begin(), _keys.end(), key); // collides with padding
+
+		int lower_bound = INT_MAX;
+		size_t k = 0;
+		while (k < _nblocks)
+		{
+			size_t i = rank(&_tree[k * B], key);
+			if (i < B) lower_bound = _tree[k * B + i];
+			k = child(k, i);
+		}
+		return lower_bound == key;
+	}
+
+	bool insert(int key)
+	{
+		auto it = std::lower_bound(_keys.begin(), _keys.end(), key);
+		if (it != _keys.end() && *it == key) return false;
+		_keys.insert(it, key);
+		_stale.dirty.store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool erase(int key)
+	{
+		auto it = std::lower_bound(_keys.begin(), _keys.end(), key);
+		if (it == _keys.end() || *it != key) return false;
+		_keys.erase(it);
+		_stale.dirty.store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	size_t size() const
+	{
+		return _keys.size();
+	}
+};
+
+
+// epoch-based reclamation shared by the concurrent containers: readers announce
+// the epoch they entered in, a retired node is freed only after every reader
+// that could still see it has left
+class EpochDomain
+{
+public:
+	static const int max_threads = 256;
+
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> epoch; // 0 while the thread is outside a read section
+		std::atomic<bool> used;
+	};
+
+	std::atomic<uint64_t> _epoch;
+	Slot _slots[max_threads];
+
+	// a thread claims a slot on first use and gives it back when it exits
+	struct Registration
+	{
+		Slot* slot;
+
+		Registration() : slot(nullptr)
+		{
+			EpochDomain& domain = instance();
+			for (int i = 0; i < max_threads && !slot; ++i)
+			{
+				bool expected = false;
+				if (domain._slots[i].used.compare_exchange_strong(expected, true)) slot = &domain._slots[i];
+			}
+			if (!slot) throw std::runtime_error("EpochDomain: too many threads");
+		}
+
+		~Registration()
+		{
+			slot->epoch.store(0);
+			slot->used.store(false);
+		}
+	};
+
+	EpochDomain() : _epoch(1)
+	{
+		for (Slot& slot : _slots)
+		{
+			slot.epoch.store(0);
+			slot.used.store(false);
+		}
+	}
+
+public:
+	static EpochDomain& instance()
+	{
+		static EpochDomain domain;
+		return domain;
+	}
+
+	static Slot& local_slot()
+	{
+		static thread_local Registration registration;
+		return *registration.slot;
+	}
+
+	uint64_t epoch() const
+	{
+		return _epoch.load();
+	}
+
+	uint64_t advance()
+	{
+		return _epoch.fetch_add(1) + 1;
+	}
+
+	// oldest epoch a reader is still in, or the current one when nobody reads
+	uint64_t min_active() const
+	{
+		uint64_t result = _epoch.load();
+		for (const Slot& slot : _slots)
+		{
+			uint64_t e = slot.epoch.load();
+			if (e != 0 && e < result) result = e;
+		}
+		return result;
+	}
+
+	// RAII read section, not reentrant
+	class Guard
+	{
+		Slot& _slot;
+
+	public:
+		Guard() : _slot(local_slot())
+		{
+			_slot.epoch.store(instance().epoch());
+		}
+
+		~Guard()
+		{
+			_slot.epoch.store(0, std::memory_order_release);
+		}
+	};
+};
+
+
+// Set for many reader threads and concurrent writers. Keys are spread over
+// shards; each shard is an immutable AVL tree that writers replace by path
+// copying under the shard mutex. contains() takes no lock and writes nothing
+// shared: it enters an epoch, loads the shard root and descends.
+class ConcurrentSet
+{
+	template<typename, typename> friend class PathCopy;
+
+	struct CNode
+	{
+		int key;
+		int height;
+		const CNode* left;
+		const CNode* right;
+	};
+
+	struct Retired
+	{
+		const CNode* node;
+		uint64_t epoch;
+	};
+
+	struct alignas(64) Shard
+	{
+		std::atomic<const CNode*> root;
+		std::atomic<size_t> size;
+		std::mutex lock; // serializes writers of this shard
+		std::vector<Retired> retired;
+	};
+
+	static const size_t shard_count = 16;
+	static const size_t reclaim_batch = 64;
+
+	Shard _shards[shard_count];
+
+	static uint32_t mix(uint32_t x)
+	{
+		x ^= x >> 16; x *= 0x85EBCA6Bu;
+		x ^= x >> 13; x *= 0xC2B2AE35u;
+		x ^= x >> 16;
+		return x;
+	}
+
+	Shard& shard(int key)
+	{
+		return _shards[mix(static_cast<uint32_t>(key)) >> 28];
+	}
+
+	const Shard& shard(int key) const
+	{
+		return _shards[mix(static_cast<uint32_t>(key)) >> 28];
+	}
+
+	static int height(const CNode* node)
+	{
+		return node ? node->height : 0;
+	}
+
+	static const CNode& node(const CNode* node)
+	{
+		return *node;
+	}
+
+	static const CNode* make(int key, const CNode* left, const CNode* right)
+	{
+		return new CNode{ key, 1 + std::max(height(left), height(right)), left, right };
+	}
+
+	static void free_tree(const CNode* node)
+	{
+		if (!node) return;
+		free_tree(node->left);
+		free_tree(node->right);
+		delete node;
+	}
+
+	// publishes the new root, then frees what no reader can reach any more; shard lock held
+	void publish(Shard& s, const CNode* root, std::vector<const CNode*>& old)
+	{
+		EpochDomain& domain = EpochDomain::instance();
+		s.root.store(root);
+		uint64_t epoch = domain.epoch();
+		for (const CNode* node : old) s.retired.push_back(Retired{ node, epoch });
+		if (s.retired.size() < reclaim_batch) return;
+
+		domain.advance();
+		uint64_t safe = domain.min_active();
+		size_t kept = 0;
+		for (const Retired& r : s.retired)
+		{
+			if (r.epoch < safe) delete r.node;
+			else s.retired[kept++] = r;
+		}
+		s.retired.resize(kept);
+	}
+
+public:
+	ConcurrentSet()
+	{
+		for (Shard& s : _shards)
+		{
+			s.root.store(nullptr);
+			s.size.store(0);
+		}
+	}
+
+	ConcurrentSet(const ConcurrentSet&) = delete;
+	ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+	// no thread may use the set any more
+	~ConcurrentSet()
+	{
+		for (Shard& s : _shards)
+		{
+			free_tree(s.root.load());
+			for (const Retired& r : s.retired) delete r.node;
+		}
+	}
+
+	bool contains(int key) const
+	{
+		EpochDomain::Guard guard;
+		const CNode* node = shard(key).root.load();
+		while (node)
+		{
+			if (node->key == key) return true;
+			node = key < node->key ? node->left : node->right;
+		}
+		return false;
+	}
+
+	bool insert(int key)
+	{
+		Shard& s = shard(key);
+		std::lock_guard<std::mutex> lock(s.lock);
+		std::vector<const CNode*> old;
+		const CNode* root = s.root.load();
+		const CNode* new_root = PathCopy<ConcurrentSet, const CNode*>(*this, old).insert(root, key);
+		if (new_root == root) return false;
+		publish(s, new_root, old);
+		s.size.fetch_add(1);
+		return true;
+	}
+
+	bool erase(int key)
+	{
+		Shard& s = shard(key);
+		std::lock_guard<std::mutex> lock(s.lock);
+		std::vector<const CNode*> old;
+		const CNode* root = s.root.load();
+		const CNode* new_root = PathCopy<ConcurrentSet, const CNode*>(*this, old).erase(root, key);
+		if (old.empty()) return false;
+		publish(s, new_root, old);
+		s.size.fetch_sub(1);
+		return true;
+	}
+
+	size_t size() const
+	{
+		size_t result = 0;
+		for (const Shard& s : _shards) result += s.size.load();
+		return result;
+	}
+};
+
+
+// Set backend for bounded dense integer keys, roaring style: keys are grouped
+// by their high 16 bits, each group is a sorted uint16_t array while it holds
+// at most 4096 keys and a 65536-bit bitmap once it is denser
+class RoaringSet
+{
+	static const size_t array_limit = 4096;
+	static const size_t bitmap_words = 65536 / 64;
+
+	struct Container
+	{
+		uint16_t high;
+		uint32_t cardinality;
+		std::vector<uint16_t> array; // used while bitmap is empty
+		std::vector<uint64_t> bitmap;
+
+		explicit Container(uint16_t high) : high(high), cardinality(0) {}
+
+		bool is_bitmap() const { return !bitmap.empty(); }
+
+		bool contains(uint16_t low) const
+		{
+			if (is_bitmap()) return (bitmap[low >> 6] >> (low & 63)) & 1;
+			return std::binary_search(array.begin(), array.end(), low);
+		}
+
+		bool insert(uint16_t low)
+		{
+			if (is_bitmap())
+			{
+				uint64_t& word = bitmap[low >> 6];
+				uint64_t bit = uint64_t(1) << (low & 63);
+				if (word & bit) return false;
+				word |= bit;
+				++cardinality;
+				return true;
+			}
+			auto it = std::lower_bound(array.begin(), array.end(), low);
+			if (it != array.end() && *it == low) return false;
+			array.insert(it, low);
+			++cardinality;
+			if (cardinality > array_limit) to_bitmap();
+			return true;
+		}
+
+		bool erase(uint16_t low)
+		{
+			if (is_bitmap())
+			{
+				uint64_t& word = bitmap[low >> 6];
+				uint64_t bit = uint64_t(1) << (low & 63);
+				if (!(word & bit)) return false;
+				word &= ~bit;
+				if (--cardinality <= array_limit) to_array();
+				return true;
+			}
+			auto it = std::lower_bound(array.begin(), array.end(), low);
+			if (it == array.end() || *it != low) return false;
+			array.erase(it);
+			--cardinality;
+			return true;
+		}
+
+		void to_bitmap()
+		{
+			bitmap.assign(bitmap_words, 0);
+			for (uint16_t low : array) bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+			std::vector<uint16_t>().swap(array);
+		}
+
+		void to_array()
+		{
+			array.clear();
+			array.reserve(cardinality);
+			for (size_t w = 0; w < bitmap_words; ++w)
+			{
+				for (uint64_t word = bitmap[w]; word; word &= word - 1)
+					array.push_back(static_cast<uint16_t>(w * 64 + std::countr_zero(word)));
+			}
+			std::vector<uint64_t>().swap(bitmap);
+		}
+
+		// picks the representation after a bulk word-wise operation
+		void normalize()
+		{
+			if (is_bitmap())
+			{
+				cardinality = 0;
+				for (uint64_t word : bitmap) cardinality += std::popcount(word);
+				if (cardinality <= array_limit) to_array();
+			}
+			else
+			{
+				cardinality = static_cast<uint32_t>(array.size());
+				if (cardinality > array_limit) to_bitmap();
+			}
+		}
+
+		size_t bytes() const
+		{
+			return sizeof(Container) + array.capacity() * sizeof(uint16_t) + bitmap.capacity() * sizeof(uint64_t);
+		}
+	};
+
+	std::vector<Container> _containers; // sorted by high
+	size_t _size;
+
+	// order-preserving map of int onto uint32_t
+	static uint32_t to_unsigned(int key) { return static_cast<uint32_t>(key) ^ 0x80000000u; }
+	static int to_key(uint32_t value) { return static_cast<int>(value ^ 0x80000000u); }
+
+	std::vector<Container>::iterator find(uint16_t high)
+	{
+		return std::lower_bound(_containers.begin(), _containers.end(), high,
+			[](const Container& c, uint16_t h) { return c.high < h; });
+	}
+
+	std::vector<Container>::const_iterator find(uint16_t high) const
+	{
+		return std::lower_bound(_containers.begin(), _containers.end(), high,
+			[](const Container& c, uint16_t h) { return c.high < h; });
+	}
+
+	enum class Operation { intersect, subtract, unite };
+
+	static std::vector<uint64_t> as_bitmap(const Container& c)
+	{
+		if (c.is_bitmap()) return c.bitmap;
+		std::vector<uint64_t> bitmap(bitmap_words, 0);
+		for (uint16_t low : c.array) bitmap[low >> 6] |= uint64_t(1) << (low & 63);
+		return bitmap;
+	}
+
+	// combines two containers with the same high bits; bitmap pairs go word by word
+	static Container combine(const Container& a, const Container& b, Operation op)
+	{
+		Container result(a.high);
+		if (!a.is_bitmap() && !b.is_bitmap())
+		{
+			if (op == Operation::intersect)
+				std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+			else if (op == Operation::subtract)
+				std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+			else
+				std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+		}
+		else if (op == Operation::intersect && !a.is_bitmap())
+		{
+			for (uint16_t low : a.array) if (b.contains(low)) result.array.push_back(low);
+		}
+		else if (op == Operation::intersect && !b.is_bitmap())
+		{
+			for (uint16_t low : b.array) if (a.contains(low)) result.array.push_back(low);
+		}
+		else if (op == Operation::subtract && !a.is_bitmap())
+		{
+			for (uint16_t low : a.array) if (!b.contains(low)) result.array.push_back(low);
+		}
+		else
+		{
+			result.bitmap = as_bitmap(a);
+			std::vector<uint64_t> other = as_bitmap(b);
+			uint64_t* out = result.bitmap.data();
+			const uint64_t* in = other.data();
+			if (op == Operation::intersect)
+				for (size_t w = 0; w < bitmap_words; ++w) out[w] &= in[w];
+			else if (op == Operation::subtract)
+				for (size_t w = 0; w < bitmap_words; ++w) out[w] &= ~in[w];
+			else
+				for (size_t w = 0; w < bitmap_words; ++w) out[w] |= in[w];
+		}
+		result.normalize();
+		return result;
+	}
+
+	static RoaringSet merge(const RoaringSet& first, const RoaringSet& second, Operation op)
+	{
+		RoaringSet result;
+		size_t i = 0, j = 0;
+		while (i < first._containers.size() || j < second._containers.size())
+		{
+			bool has_a = i < first._containers.size(), has_b = j < second._containers.size();
+			if (has_a && (!has_b || first._containers[i].high < second._containers[j].high))
+			{
+				if (op != Operation::intersect) result._containers.push_back(first._containers[i]);
+				++i;
+			}
+			else if (has_b && (!has_a || second._containers[j].high < first._containers[i].high))
+			{
+				if (op == Operation::unite) result._containers.push_back(second._containers[j]);
+				++j;
+			}
+			else
+			{
+				Container c = combine(first._containers[i++], second._containers[j++], op);
+				if (c.cardinality) result._containers.push_back(std::move(c));
+			}
+		}
+		for (const Container& c : result._containers) result._size += c.cardinality;
+		return result;
+	}
+
+public:
+	RoaringSet() : _size(0) {}
+
+	RoaringSet(std::initializer_list<int> list) : _size(0)
+	{
+		for (int x : list) insert(x);
+	}
+
+	bool contains(int key) const
+	{
+		uint32_t value = to_unsigned(key);
+		uint16_t high = static_cast<uint16_t>(value >> 16);
+		auto it = find(high);
+		return it != _containers.end() && it->high == high && it->contains(static_cast<uint16_t>(value));
+	}
+
+	bool insert(int key)
+	{
+		uint32_t value = to_unsigned(key);
+		uint16_t high = static_cast<uint16_t>(value >> 16);
+		auto it = find(high);
+		if (it == _containers.end() || it->high != high) it = _containers.insert(it, Container(high));
+		if (!it->insert(static_cast<uint16_t>(value))) return false;
+		++_size;
+		return true;
+	}
+
+	bool erase(int key)
+	{
+		uint32_t value = to_unsigned(key);
+		uint16_t high = static_cast<uint16_t>(value >> 16);
+		auto it = find(high);
+		if (it == _containers.end() || it->high != high || !it->erase(static_cast<uint16_t>(value))) return false;
+		if (it->cardinality == 0) _containers.erase(it);
+		--_size;
+		return true;
+	}
+
+	size_t size() const
+	{
+		return _size;
+	}
+
+	bool empty() const
+	{
+		return _size == 0;
+	}
+
+	size_t bytes() const
+	{
+		size_t result = sizeof(RoaringSet);
+		for (const Container& c : _containers) result += c.bytes();
+		return result;
+	}
+
+	// calls func(key) for every key in ascending order
+	template<typename Func>
+	void for_each(Func func) const
+	{
+		for (const Container& c : _containers)
+		{
+			uint32_t base = uint32_t(c.high) << 16;
+			if (c.is_bitmap())
+			{
+				for (size_t w = 0; w < bitmap_words; ++w)
+				{
+					for (uint64_t word = c.bitmap[w]; word; word &= word - 1)
+						func(to_key(base | static_cast<uint32_t>(w * 64 + std::countr_zero(word))));
+				}
+			}
+			else
+			{
+				for (uint16_t low : c.array) func(to_key(base | low));
+			}
+		}
+	}
+
+	friend RoaringSet intersection(const RoaringSet& first, const RoaringSet& second)
+	{
+		return merge(first, second, Operation::intersect);
+	}
 
-	Node() : key(0), left(nullptr), right(nullptr) {}
-	Node(int key) : left(nullptr), right(nullptr)
+	friend RoaringSet difference(const RoaringSet& first, const RoaringSet& second)
 	{
-		this->key = key;
+		return merge(first, second, Operation::subtract);
+	}
+
+	friend RoaringSet set_union(const RoaringSet& first, const RoaringSet& second)
+	{
+		return merge(first, second, Operation::unite);
 	}
 };
 
 
-class Set
+// compile-time backend choice: RoaringSet when keys come from a bounded dense domain
+template<bool DenseKeys>
+using SetBackend = typename std::conditional<DenseKeys, RoaringSet, Set>::type;
+
+
+// on-disk Set: a 16-byte header ("LSET", version, key count) followed by the
+// keys in ascending order. SetSnapshot maps the file read-only and answers
+// lookups straight from the mapped pages, nothing is deserialized.
+class SetSnapshot
 {
-	Node* _root;
-	Node* copy_tree(Node* root)
+	struct Header
 	{
-		if (root == nullptr)
-		{
-			return nullptr;
-		}
-		else
-		{
-			Node* new_node = new Node(root->key);
-			new_node->left = copy_tree(root->left);
-			new_node->right = copy_tree(root->right);
-			return new_node;
-		}
+		char magic[4];
+		uint32_t version;
+		uint64_t count;
+	};
+
+	const char* _data;
+	size_t _length;
+	const int* _keys;
+	size_t _count;
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#else
+	int _file;
+#endif
+
+	void unmap()
+	{
+#ifdef _WIN32
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+		_mapping = nullptr;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_data) munmap(const_cast<char*>(_data), _length);
+		if (_file >= 0) close(_file);
+		_file = -1;
+#endif
+		_data = nullptr;
+		_keys = nullptr;
+		_length = _count = 0;
 	}
-	void _print(const Node* root)
+
+public:
+	static const uint32_t version = 1;
+
+	// streams the keys of set in order, in blocks, without building a copy
+	static void write(const Set& set, const std::string& path)
 	{
-		if (!root) return;
-		_print(root->left);
-		std::cout << root->key << " ";
-		_print(root->right);
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) throw std::runtime_error("SetSnapshot: cannot create " + path);
+		Header header = { { 'L', 'S', 'E', 'T' }, version, set.size() };
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		const size_t block = 1 << 16;
+		std::vector<int> buffer;
+		buffer.reserve(block);
+		set.for_each([&](int key) {
+			buffer.push_back(key);
+			if (buffer.size() == block)
+			{
+				out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(int));
+				buffer.clear();
+			}
+			});
+		out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(int));
+		if (!out) throw std::runtime_error("SetSnapshot: write to " + path + " failed");
 	}
-	bool _erase(Node*& node, const int key)
+
+	explicit SetSnapshot(const std::string& path) : _data(nullptr), _length(0), _keys(nullptr), _count(0)
 	{
-		if (node == nullptr) {
-			return false;
+#ifdef _WIN32
+		_mapping = nullptr;
+		_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size))
+		{
+			unmap();
+			throw std::runtime_error("SetSnapshot: cannot open " + path);
 		}
-		if (key < node->key) {
-			return _erase(node->left, key);
+		_length = static_cast<size_t>(size.QuadPart);
+		if (_length >= sizeof(Header))
+		{
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (_mapping) _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
 		}
-		else if (key > node->key) {
-			return _erase(node->right, key);
+#else
+		_file = open(path.c_str(), O_RDONLY);
+		struct stat info;
+		if (_file < 0 || fstat(_file, &info) != 0)
+		{
+			unmap();
+			throw std::runtime_error("SetSnapshot: cannot open " + path);
 		}
-		else {
-			if (node->left == nullptr) {
-				Node* tmp = node->right;
-				delete node;
-				node = tmp;
-				return true;
-			}
-			else if (node->right == nullptr) {
-				Node* tmp = node->left;
-				delete node;
-				node = tmp;
-				return true;
-			}
-			Node* min_right = node->right;
-			while (min_right->left) {
-				min_right = min_right->left;
-			}
-
-			node->key = min_right->key;
-			return _erase(node->right, min_right->key);
+		_length = static_cast<size_t>(info.st_size);
+		if (_length >= sizeof(Header))
+		{
+			void* address = mmap(nullptr, _length, PROT_READ, MAP_SHARED, _file, 0);
+			if (address != MAP_FAILED) _data = static_cast<const char*>(address);
+		}
+#endif
+		// count is bounded by the bytes that follow the header before it is
+		// multiplied, so a forged count cannot wrap the size check around
+		const Header* header = reinterpret_cast<const Header*>(_data);
+		if (!_data || std::memcmp(header->magic, "LSET", 4) != 0 || header->version != version
+			|| header->count > (_length - sizeof(Header)) / sizeof(int)
+			|| _length != sizeof(Header) + static_cast<size_t>(header->count) * sizeof(int))
+		{
+			unmap();
+			throw std::runtime_error("SetSnapshot: " + path + " is not a valid snapshot");
 		}
+		_count = static_cast<size_t>(header->count);
+		_keys = reinterpret_cast<const int*>(_data + sizeof(Header));
 	}
 
-	void clear(Node* root)
+	SetSnapshot(const SetSnapshot&) = delete;
+	SetSnapshot& operator=(const SetSnapshot&) = delete;
+
+	~SetSnapshot()
 	{
-		if (!root) return;
-		clear(root->left);
-		clear(root->right);
-		delete root;
+		unmap();
 	}
 
-public:
-	Set() : _root(nullptr) {}
-
-	Set(std::initializer_list<int> list) : _root(nullptr)
+	// branchless binary search, both possible next probes are prefetched
+	bool contains(int key) const
 	{
-		for (int x : list)
+		if (_count == 0) return false;
+		const int* base = _keys;
+		size_t length = _count;
+		while (length > 1)
 		{
-			insert(x);
+			size_t half = length / 2;
+			prefetch(base + half / 2);
+			prefetch(base + half + half / 2);
+			base = base[half] <= key ? base + half : base;
+			length -= half;
 		}
+		return *base == key;
 	}
-	Set(const Set& other) : _root(nullptr) // deep copy constr
+
+	size_t size() const
 	{
-		_root = copy_tree(other.get_root());
+		return _count;
 	}
 
-	~Set()
+	// the mapped keys, ascending; Set(snapshot.begin(), snapshot.end()) loads it back
+	const int* begin() const
 	{
-		clear(_root);
-		_root = nullptr;
+		return _keys;
 	}
 
-	void print()
+	const int* end() const
 	{
-		if (!_root) return;
-		_print(_root);
+		return _keys + _count;
 	}
+};
 
-	bool insert(int key)
+
+// plain unbalanced BST, kept as the baseline for the balanced Set benchmark
+class BSTSet
+{
+	struct BSTNode
 	{
-		if (!_root)
+		int key;
+		BSTNode* left;
+		BSTNode* right;
+
+		BSTNode(int key) : key(key), left(nullptr), right(nullptr) {}
+	};
+
+	BSTNode* _root;
+
+public:
+	BSTSet() : _root(nullptr) {}
+	BSTSet(const BSTSet&) = delete;
+	BSTSet& operator=(const BSTSet&) = delete;
+
+	~BSTSet()
+	{
+		// iterative, a degenerate tree is as deep as it is large
+		std::vector<BSTNode*> stack;
+		if (_root) stack.push_back(_root);
+		while (!stack.empty())
 		{
-			_root = new Node(key);
-			return true;
+			BSTNode* node = stack.back();
+			stack.pop_back();
+			if (node->left) stack.push_back(node->left);
+			if (node->right) stack.push_back(node->right);
+			delete node;
 		}
+	}
 
-		Node* tmp = _root;
-		while (tmp && tmp->key != key)
+	bool insert(int key)
+	{
+		BSTNode** link = &_root;
+		while (*link)
 		{
-			if (key < tmp->key)
-			{
-				if (tmp->left) tmp = tmp->left;
-				else
-				{
-					tmp->left = new Node(key);
-					return true;
-				}
-			}
-			else
-			{
-				if (tmp->right) tmp = tmp->right;
-				else
-				{
-					tmp->right = new Node(key);
-					return true;
-				}
-			}
+			if (key == (*link)->key) return false;
+			link = key < (*link)->key ? &(*link)->left : &(*link)->right;
 		}
-
-		return false;
+		*link = new BSTNode(key);
+		return true;
 	}
 
 	bool contains(int key) const
 	{
-		if (!_root) return false;
-		Node* tmp = _root;
+		BSTNode* tmp = _root;
 		while (tmp)
 		{
 			if (tmp->key == key) return true;
-			if (key < tmp->key)
-			{
-				tmp = tmp->left;
-			}
-			else
-			{
-				tmp = tmp->right;
-			}
+			tmp = key < tmp->key ? tmp->left : tmp->right;
 		}
-
 		return false;
 	}
+};
 
-	bool erase(int key)
-	{
-		return _erase(_root, key);
+
+size_t lcg()
+{
+	static size_t x = 0;
+	x = (1021 * x + 24631) % 116640;
+	return x;
+}
+
+
+
+template<typename Func>
+double measure_execution_time(Func&& func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto end = std::chrono::steady_clock::now();
+	auto elapsed_time = std::chrono::duration<double, std::milli>(end - start).count();
+	return elapsed_time;
+}
+
+template<typename SetType>
+void benchmark_tree(const char* name, const char* input, const std::vector<int>& keys)
+{
+	SetType set;
+	double fill_time = measure_execution_time([&]() {
+		for (int key : keys) {
+			set.insert(key);
+		}
+		});
+	size_t found = 0;
+	double search_time = measure_execution_time([&]() {
+		for (int key : keys) {
+			found += set.contains(key);
+		}
+		});
+	cout << name << " " << input << " size " << keys.size() << ": fill " << fill_time << " ms, search "
+		<< search_time << " ms (" << found << " found)" << endl;
+}
+
+// balanced Set against the unbalanced BST on sorted, reverse-sorted and lcg() keys
+void benchmark_balanced()
+{
+	const int sizes[] = { 1000, 10000, 30000 };
+	for (int size : sizes) {
+		std::vector<int> sorted_keys(size), reverse_keys(size), lcg_keys(size);
+		for (int j = 0; j < size; ++j) {
+			sorted_keys[j] = j;
+			reverse_keys[j] = size - j;
+			lcg_keys[j] = lcg();
+		}
+		benchmark_tree<BSTSet>("BST", "sorted", sorted_keys);
+		benchmark_tree<Set>("AVL", "sorted", sorted_keys);
+		benchmark_tree<BSTSet>("BST", "reverse", reverse_keys);
+		benchmark_tree<Set>("AVL", "reverse", reverse_keys);
+		benchmark_tree<BSTSet>("BST", "lcg", lcg_keys);
+		benchmark_tree<Set>("AVL", "lcg", lcg_keys);
+	}
+
+	// the unbalanced tree is quadratic here, only the AVL one is run at 10^6
+	std::vector<int> large(1000000);
+	for (int j = 0; j < (int)large.size(); ++j) large[j] = j;
+	benchmark_tree<Set>("AVL", "sorted", large);
+}
+
+// heap traffic of the arena-backed Set against one new/delete per node in BSTSet
+void benchmark_allocation()
+{
+	const int size = 1000000;
+	std::vector<int> keys(size);
+	for (int j = 0; j < size; ++j) {
+		keys[j] = static_cast<int>(j * 2654435761u);
+	}
+
+	BSTSet* bst = new BSTSet();
+	double bst_fill_time = measure_execution_time([&]() {
+		for (int key : keys) bst->insert(key);
+		});
+	double bst_destroy_time = measure_execution_time([&]() {
+		delete bst;
+		});
+
+	Set* set = new Set();
+	double set_fill_time = measure_execution_time([&]() {
+		for (int key : keys) set->insert(key);
+		});
+	size_t growths = set->arena().growths();
+	size_t bytes = set->arena().bytes();
+	Set* copy = nullptr;
+	double set_copy_time = measure_execution_time([&]() {
+		copy = new Set(*set);
+		});
+	double set_destroy_time = measure_execution_time([&]() {
+		delete set;
+		delete copy;
+		}) / 2;
+
+	cout << "BST size " << size << ": " << size << " node allocations, fill " << bst_fill_time
+		<< " ms, destroy " << bst_destroy_time << " ms" << endl;
+	cout << "Arena Set size " << size << ": " << growths << " arena allocations (" << bytes / 1024 << " KiB), fill "
+		<< set_fill_time << " ms, copy " << set_copy_time << " ms, destroy " << set_destroy_time << " ms" << endl;
+}
+
+// snapshot cost: a deep copy rebuilt from the keys against the O(1) Set copy,
+// each followed by one write to the copy
+void benchmark_snapshots()
+{
+	const int size = 1000000;
+	std::vector<int> keys(size);
+	for (int j = 0; j < size; ++j) {
+		keys[j] = static_cast<int>(j * 2654435761u);
+	}
+	Set set(keys);
+
+	Set deep_copy;
+	double deep_copy_time = measure_execution_time([&]() {
+		deep_copy = Set(set.begin(), set.end());
+		});
+	double deep_write_time = measure_execution_time([&]() {
+		deep_copy.insert(1);
+		});
+
+	Set set_copy;
+	double set_copy_time = measure_execution_time([&]() {
+		set_copy = set;
+		});
+	double set_write_time = measure_execution_time([&]() {
+		set_copy.insert(1);
+		});
+
+	cout << "Snapshot of size " << size << ": deep copy " << deep_copy_time << " ms + write " << deep_write_time
+		<< " ms, Set copy " << set_copy_time << " ms + write " << set_write_time << " ms ("
+		<< set.contains(1) << "/" << set_copy.contains(1) << ")" << endl;
+}
+
+// memory and set algebra of RoaringSet against Set on lcg() keys, which stay below 116640
+void benchmark_bitmap()
+{
+	const int size = 100000;
+	std::vector<int> first_keys(size), second_keys(size);
+	for (int j = 0; j < size; ++j) first_keys[j] = static_cast<int>(lcg());
+	for (int j = 0; j < size; ++j) second_keys[j] = static_cast<int>(lcg());
+
+	Set first(first_keys), second(second_keys);
+	RoaringSet first_bitmap, second_bitmap;
+	for (int key : first_keys) first_bitmap.insert(key);
+	for (int key : second_keys) second_bitmap.insert(key);
+
+	Set set_result;
+	double set_time = measure_execution_time([&]() {
+		set_result = intersection(first, second);
+		set_result = difference(first, second);
+		});
+	RoaringSet bitmap_result;
+	double bitmap_time = measure_execution_time([&]() {
+		bitmap_result = intersection(first_bitmap, second_bitmap);
+		bitmap_result = difference(first_bitmap, second_bitmap);
+		});
+
+	cout << "lcg keys, " << first.size() << " unique: Set " << double(first.arena().bytes()) / first.size()
+		<< " bytes/key, RoaringSet " << double(first_bitmap.bytes()) / first_bitmap.size() << " bytes/key" << endl;
+	cout << "intersection + difference: Set " << set_time << " ms, RoaringSet " << bitmap_time << " ms ("
+		<< set_result.size() << "/" << bitmap_result.size() << ")" << endl;
+}
+
+// warm start: rebuilding a Set with insert() against opening a mapped snapshot
+void benchmark_snapshot_file()
+{
+	const int size = 1000000;
+	const std::string path = "lab1_snapshot.bin";
+	std::vector<int> keys(size);
+	for (int j = 0; j < size; ++j) {
+		keys[j] = static_cast<int>(j * 2654435761u);
 	}
 
-	Node* get_root() const
+	Set rebuilt;
+	double rebuild_time = measure_execution_time([&]() {
+		for (int key : keys) rebuilt.insert(key);
+		});
+	double write_time = measure_execution_time([&]() {
+		SetSnapshot::write(rebuilt, path);
+		});
+
+	size_t found = 0;
+	double open_time = 0.0, lookup_time = 0.0;
 	{
-		return this->_root;
+		SetSnapshot* snapshot = nullptr;
+		open_time = measure_execution_time([&]() {
+			snapshot = new SetSnapshot(path);
+			found += snapshot->contains(keys[0]);
+			});
+		lookup_time = measure_execution_time([&]() {
+			for (int key : keys) found += snapshot->contains(key);
+			});
+		delete snapshot;
+	}
+	std::remove(path.c_str());
+
+	cout << "Warm start size " << size << ": insert rebuild " << rebuild_time << " ms, snapshot write " << write_time
+		<< " ms, snapshot open + first lookup " << open_time << " ms, " << size << " mapped lookups " << lookup_time
+		<< " ms (" << found << " found)" << endl;
+}
+
+// bulk constructor against an insert() loop on unsorted and already sorted keys
+void benchmark_bulk_build()
+{
+	const int size = 1000000;
+	std::vector<int> shuffled(size), sorted_keys(size);
+	for (int j = 0; j < size; ++j) {
+		shuffled[j] = static_cast<int>(j * 2654435761u);
+		sorted_keys[j] = j;
 	}
 
-	Set& operator=(const Set& set) // deep copy
+	const std::vector<int>* inputs[] = { &shuffled, &sorted_keys };
+	const char* names[] = { "unsorted", "sorted" };
+	for (int i = 0; i < 2; ++i) {
+		const std::vector<int>& keys = *inputs[i];
+		Set by_insert;
+		double insert_time = measure_execution_time([&]() {
+			for (int key : keys) by_insert.insert(key);
+			});
+		Set* bulk = nullptr;
+		double bulk_time = measure_execution_time([&]() {
+			bulk = new Set(keys.begin(), keys.end());
+			});
+		cout << "Set " << names[i] << " size " << size << ": insert loop " << insert_time
+			<< " ms, bulk build " << bulk_time << " ms" << endl;
+		delete bulk;
+	}
+}
+
+// ---- benchmark suite ----
+
+// keeps value observable so the measured work is not optimized away
+template<typename T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(_MSC_VER)
+	volatile char sink = *reinterpret_cast<const volatile char*>(&value);
+	(void)sink;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+
+// 64-bit splitmix generator, full 32-bit key range unlike lcg()
+class SplitMix64
+{
+	uint64_t _state;
+
+public:
+	explicit SplitMix64(uint64_t seed) : _state(seed) {}
+
+	uint64_t next()
 	{
-		if (this != &set)
-		{
-			clear(_root);
-			_root = copy_tree(set.get_root());
-		}
-		return *this;
+		uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
 	}
 };
 
 
-bool operator==(const Set& first, const Set& second)
+struct BenchResult
+{
+	std::string structure;
+	std::string operation;
+	std::string distribution;
+	size_t size;
+	size_t samples;
+	double min, median, p90, p99, mean; // ns per operation
+};
+
+
+class BenchmarkSuite
 {
-	if (first.get_root() == nullptr && second.get_root() == nullptr) return true;
+	std::vector<BenchResult> _results;
+	int _warmup_batches;
+	double _target_ms; // time budget of one measurement
 
-	std::queue<Node*> que; que.push(second.get_root());
-	while (!que.empty())
+	static double percentile(const std::vector<double>& sorted, double p)
 	{
-		Node* current = que.front();
-		if (!first.contains(current->key)) return false;
-		if (current->left) que.push(current->left);
-		if (current->right) que.push(current->right);
-		que.pop();
+		size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+		return sorted[index];
 	}
 
-	return true;
-}
+public:
+	BenchmarkSuite(int warmup_batches = 3, double target_ms = 100.0)
+		: _warmup_batches(warmup_batches), _target_ms(target_ms) {}
+
+	// batch(b) runs ops_per_batch operations; each timed batch is one sample
+	template<typename Batch>
+	BenchResult run(const std::string& structure, const std::string& operation, const std::string& distribution,
+		size_t size, size_t ops_per_batch, Batch&& batch, size_t min_samples = 5, size_t max_samples = 200)
+	{
+		for (int i = 0; i < _warmup_batches; ++i) batch(i);
 
+		std::vector<double> samples;
+		double elapsed_ms = 0.0;
+		for (size_t b = 0; b < max_samples && (b < min_samples || elapsed_ms < _target_ms); ++b)
+		{
+			auto start = steady_clock::now();
+			batch(_warmup_batches + b);
+			auto end = steady_clock::now();
+			double ns = duration<double, std::nano>(end - start).count();
+			samples.push_back(ns / ops_per_batch);
+			elapsed_ms += ns / 1e6;
+		}
 
-Set intersection(const Set& first, const Set& second)
-{
-	if (!first.get_root() || !second.get_root()) return Set();
-	Set result;
-	Set copy_first(first);
+		std::sort(samples.begin(), samples.end());
+		BenchResult result;
+		result.structure = structure;
+		result.operation = operation;
+		result.distribution = distribution;
+		result.size = size;
+		result.samples = samples.size();
+		result.min = samples.front();
+		result.median = percentile(samples, 0.5);
+		result.p90 = percentile(samples, 0.9);
+		result.p99 = percentile(samples, 0.99);
+		double total = 0.0;
+		for (double sample : samples) total += sample;
+		result.mean = total / samples.size();
+		_results.push_back(result);
+
+		cout << structure << " " << operation << " " << distribution << " size " << size << ": median "
+			<< result.median << " ns/op, p90 " << result.p90 << ", p99 " << result.p99
+			<< " (" << result.samples << " samples)" << endl;
+		return _results.back();
+	}
 
-	std::queue<Node*> que; que.push(second.get_root());
-	while (!que.empty())
+	void write_csv(const std::string& path) const
 	{
-		Node* current = que.front();
-		if (!copy_first.insert(current->key)) result.insert(current->key);
-		if (current->left) que.push(current->left);
-		if (current->right) que.push(current->right);
-		que.pop();
+		std::ofstream out(path);
+		out << "structure,operation,distribution,size,samples,min_ns,median_ns,p90_ns,p99_ns,mean_ns\n";
+		for (const BenchResult& r : _results)
+		{
+			out << r.structure << ',' << r.operation << ',' << r.distribution << ',' << r.size << ',' << r.samples << ','
+				<< r.min << ',' << r.median << ',' << r.p90 << ',' << r.p99 << ',' << r.mean << '\n';
+		}
 	}
 
-	return result;
-}
+	void write_json(const std::string& path) const
+	{
+		std::ofstream out(path);
+		out << "[\n";
+		for (size_t i = 0; i < _results.size(); ++i)
+		{
+			const BenchResult& r = _results[i];
+			out << "  {\"structure\": \"" << r.structure << "\", \"operation\": \"" << r.operation
+				<< "\", \"distribution\": \"" << r.distribution << "\", \"size\": " << r.size
+				<< ", \"samples\": " << r.samples << ", \"min_ns\": " << r.min << ", \"median_ns\": " << r.median
+				<< ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99 << ", \"mean_ns\": " << r.mean << "}"
+				<< (i + 1 < _results.size() ? ",\n" : "\n");
+		}
+		out << "]\n";
+	}
+};
 
 
-Set difference(const Set& first, const Set& second)
+// adapters so every structure is driven through the same calls
+inline bool bench_contains(const Set& s, int key) { return s.contains(key); }
+inline bool bench_contains(const FlatSet& s, int key) { return s.contains(key); }
+inline bool bench_contains(const RoaringSet& s, int key) { return s.contains(key); }
+inline bool bench_contains(const std::set<int>& s, int key) { return s.count(key) != 0; }
+inline bool bench_contains(const std::unordered_set<int>& s, int key) { return s.count(key) != 0; }
+inline bool bench_contains(const std::vector<int>& v, int key) { return std::find(v.begin(), v.end(), key) != v.end(); }
+
+inline bool bench_insert(Set& s, int key) { return s.insert(key); }
+inline bool bench_insert(FlatSet& s, int key) { return s.insert(key); }
+inline bool bench_insert(RoaringSet& s, int key) { return s.insert(key); }
+inline bool bench_insert(std::set<int>& s, int key) { return s.insert(key).second; }
+inline bool bench_insert(std::unordered_set<int>& s, int key) { return s.insert(key).second; }
+inline bool bench_insert(std::vector<int>& v, int key) { v.push_back(key); return true; }
+
+inline bool bench_erase(Set& s, int key) { return s.erase(key); }
+inline bool bench_erase(FlatSet& s, int key) { return s.erase(key); }
+inline bool bench_erase(RoaringSet& s, int key) { return s.erase(key); }
+inline bool bench_erase(std::set<int>& s, int key) { return s.erase(key) != 0; }
+inline bool bench_erase(std::unordered_set<int>& s, int key) { return s.erase(key) != 0; }
+
+
+// keys in insertion order, present keys in lookup order and absent keys
+struct Workload
 {
-	if (!first.get_root()) return Set();
-	if (!second.get_root()) return Set(first);
-	Set result;
-	Set copy_second(second);
+	std::string distribution;
+	std::vector<int> keys;
+	std::vector<int> hits;
+	std::vector<int> misses;
+};
+
 
-	std::queue<Node*> que; que.push(first.get_root());
-	while (!que.empty())
+Workload make_workload(const std::string& distribution, size_t size, uint64_t seed)
+{
+	SplitMix64 rng(seed);
+	Workload w;
+	w.distribution = distribution;
+	std::vector<int> all;
+	if (distribution == "sequential")
+	{
+		// even keys in ascending order, odd keys miss inside the same range
+		for (size_t i = 0; i < size; ++i) w.keys.push_back(static_cast<int>(2 * i));
+		for (size_t i = 0; i < size; ++i) w.misses.push_back(static_cast<int>(2 * i + 1));
+	}
+	else
 	{
-		Node* current = que.front();
-		if (copy_second.insert(current->key)) result.insert(current->key);
-		if (current->left) que.push(current->left);
-		if (current->right) que.push(current->right);
-		que.pop();
+		// uniform: full 32-bit range; clustered: dense runs of 1024 keys at random bases
+		size_t run = distribution == "clustered" ? 1024 : 1;
+		while (all.size() < 2 * size)
+		{
+			int base = static_cast<int>(rng.next());
+			for (size_t i = 0; i < run && all.size() < 2 * size; ++i) all.push_back(base + static_cast<int>(i));
+			if (all.size() >= 2 * size)
+			{
+				sort_unique(all);
+			}
+		}
+		std::shuffle(all.begin(), all.end(), std::mt19937_64(rng.next()));
+		w.keys.assign(all.begin(), all.begin() + size);
+		w.misses.assign(all.begin() + size, all.begin() + 2 * size);
 	}
+	w.hits = w.keys;
+	std::shuffle(w.hits.begin(), w.hits.end(), std::mt19937_64(rng.next()));
+	std::shuffle(w.misses.begin(), w.misses.end(), std::mt19937_64(rng.next()));
+	return w;
+}
 
-	return result;
+
+// returns the hit and miss results
+template<typename S>
+std::pair<BenchResult, BenchResult> bench_lookups(BenchmarkSuite& suite, const std::string& name, const S& s,
+	const Workload& w, size_t batch_size)
+{
+	BenchResult hit = suite.run(name, "search_hit", w.distribution, w.keys.size(), batch_size, [&](size_t b) {
+		size_t found = 0;
+		size_t offset = b * batch_size;
+		for (size_t i = 0; i < batch_size; ++i) found += bench_contains(s, w.hits[(offset + i) % w.hits.size()]);
+		do_not_optimize(found);
+		});
+	BenchResult miss = suite.run(name, "search_miss", w.distribution, w.keys.size(), batch_size, [&](size_t b) {
+		size_t found = 0;
+		size_t offset = b * batch_size;
+		for (size_t i = 0; i < batch_size; ++i) found += bench_contains(s, w.misses[(offset + i) % w.misses.size()]);
+		do_not_optimize(found);
+		});
+	return std::make_pair(hit, miss);
 }
 
 
-size_t lcg()
+// contains_batch() against the contains() loop measured by bench_lookups
+void bench_batch_lookups(BenchmarkSuite& suite, const Set& s, const Workload& w, const BenchResult& single_hit,
+	const BenchResult& single_miss)
 {
-	static size_t x = 0;
-	x = (1021 * x + 24631) % 116640;
-	return x;
+	const size_t batch_size = 1024;
+	std::unique_ptr<bool[]> results(new bool[batch_size]);
+	const std::vector<int>* streams[] = { &w.hits, &w.misses };
+	const char* operations[] = { "search_hit_batch", "search_miss_batch" };
+	const BenchResult* singles[] = { &single_hit, &single_miss };
+	for (int k = 0; k < 2; ++k) {
+		const std::vector<int>& stream = *streams[k];
+		std::vector<int> keys(batch_size);
+		BenchResult batched = suite.run("Set", operations[k], w.distribution, w.keys.size(), batch_size, [&](size_t b) {
+			size_t offset = b * batch_size;
+			for (size_t i = 0; i < batch_size; ++i) keys[i] = stream[(offset + i) % stream.size()];
+			s.contains_batch(keys, std::span<bool>(results.get(), batch_size));
+			size_t found = 0;
+			for (size_t i = 0; i < batch_size; ++i) found += results[i];
+			do_not_optimize(found);
+			});
+		cout << "Set " << operations[k] << " " << w.distribution << " size " << w.keys.size() << ": speedup "
+			<< singles[k]->median / batched.median << "x over single contains()" << endl;
+	}
 }
 
 
+// per-structure extras, only Set has a batch API
+template<typename S>
+void bench_extra(BenchmarkSuite&, const S&, const Workload&, const std::pair<BenchResult, BenchResult>&) {}
 
-template<typename Func>
-double measure_execution_time(Func&& func) {
-	auto start = std::chrono::high_resolution_clock::now();
-	func();
-	auto end = std::chrono::high_resolution_clock::now();
-	auto elapsed_time = std::chrono::duration<double, std::milli>(end - start).count();
-	return elapsed_time;
+void bench_extra(BenchmarkSuite& suite, const Set& s, const Workload& w, const std::pair<BenchResult, BenchResult>& single)
+{
+	bench_batch_lookups(suite, s, w, single.first, single.second);
 }
 
-int main() {
-	const int num_trials_fill = 100;
-	const int num_trials_search = 1000;
-	const int sizes[] = { 1000, 10000, 100000 };
 
-	for (int size : sizes) {
-		double total_time_set_fill = 0.0;
-		double total_time_set_search = 0.0;
-		double total_time_set_insert = 0.0;
-		double total_time_set_erase = 0.0;
-		double total_time_vector_fill = 0.0;
-		double total_time_vector_search = 0.0;
-		double total_time_vector_insert = 0.0;
-		double total_time_vector_erase = 0.0;
-
-		for (int i = 0; i < num_trials_fill; ++i) {
-			// Fill Set
-			Set my_set;
-			auto set_fill_time = measure_execution_time([&]() {
-				for (int j = 0; j < size; ++j) {
-					my_set.insert(lcg());
-				}
-				});
-			total_time_set_fill += set_fill_time;
+template<typename S>
+void bench_structure(BenchmarkSuite& suite, const std::string& name, const Workload& w)
+{
+	const size_t size = w.keys.size();
+	const size_t batch_size = 1000;
 
-			// Fill vector
-			std::vector<int> my_vector;
-			auto vector_fill_time = measure_execution_time([&]() {
-				for (int j = 0; j < size; ++j) {
-					my_vector.push_back(lcg());
-				}
-				});
-			total_time_vector_fill += vector_fill_time;
+	// fill from empty, one sample per rebuild
+	suite.run(name, "fill", w.distribution, size, size, [&](size_t) {
+		S s;
+		for (int key : w.keys) bench_insert(s, key);
+		do_not_optimize(s);
+		}, 3, size >= 1000000 ? 3 : 20);
+
+	S s;
+	for (int key : w.keys) bench_insert(s, key);
+	std::pair<BenchResult, BenchResult> single = bench_lookups(suite, name, s, w, batch_size);
+	bench_extra(suite, s, w, single);
+
+	// insert an absent key and erase it again, the size stays fixed
+	suite.run(name, "insert_erase", w.distribution, size, batch_size, [&](size_t b) {
+		size_t changed = 0;
+		size_t offset = b * batch_size;
+		for (size_t i = 0; i < batch_size; ++i)
+		{
+			int key = w.misses[(offset + i) % w.misses.size()];
+			changed += bench_insert(s, key);
+			changed += bench_erase(s, key);
 		}
+		do_not_optimize(changed);
+		});
+}
 
-		double average_time_set_fill = total_time_set_fill / num_trials_fill;
-		double average_time_vector_fill = total_time_vector_fill / num_trials_fill;
 
-		cout << "Average fill time for Set with size " << size << ": " << average_time_set_fill << " ms" << endl;
-		cout << "Average fill time for vector with size " << size << ": " << average_time_vector_fill << " ms" << endl;
+// what callers do today: one mutex around a plain Set
+class LockedSet
+{
+	Set _set;
+	mutable std::mutex _lock;
 
-		// Search
-		Set my_set;
-		std::vector<int> my_vector;
-		for (int j = 0; j < size; ++j) {
-			int random_number = lcg();
-			my_set.insert(random_number);
-			my_vector.push_back(random_number);
-		}
+public:
+	bool contains(int key) const { std::lock_guard<std::mutex> lock(_lock); return _set.contains(key); }
+	bool insert(int key) { std::lock_guard<std::mutex> lock(_lock); return _set.insert(key); }
+	bool erase(int key) { std::lock_guard<std::mutex> lock(_lock); return _set.erase(key); }
+};
 
-		for (int i = 0; i < num_trials_search; ++i) {
-			int random_number = lcg();
 
-			// Search in Set
-			auto set_search_time = measure_execution_time([&]() {
-				my_set.contains(random_number);
-				});
-			total_time_set_search += set_search_time;
+// operations per second of threads hammering one set for duration_ms
+template<typename S>
+double measure_throughput(S& s, int threads, int read_percent, int key_range, double duration_ms)
+{
+	std::atomic<bool> start(false), stop(false);
+	std::atomic<size_t> total_ops(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&, t]() {
+			SplitMix64 rng(1000 + t);
+			size_t ops = 0, found = 0;
+			while (!start.load()) std::this_thread::yield();
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				for (int i = 0; i < 256; ++i, ++ops)
+				{
+					uint64_t r = rng.next();
+					int key = static_cast<int>((r >> 8) % key_range);
+					int dice = static_cast<int>(r & 0xFF) * 100 / 256;
+					if (dice < read_percent) found += s.contains(key);
+					else if (dice & 1) s.insert(key);
+					else s.erase(key);
+				}
+			}
+			do_not_optimize(found);
+			total_ops.fetch_add(ops);
+			});
+	}
+	auto begin = steady_clock::now();
+	start.store(true);
+	std::this_thread::sleep_for(duration<double, std::milli>(duration_ms));
+	stop.store(true);
+	for (std::thread& worker : workers) worker.join();
+	double seconds = duration<double>(steady_clock::now() - begin).count();
+	return total_ops.load() / seconds;
+}
 
-			// Search in vector
-			auto vector_search_time = measure_execution_time([&]() {
-				std::find(my_vector.begin(), my_vector.end(), random_number);
-				});
-			total_time_vector_search += vector_search_time;
-		}
 
-		double average_time_set_search = total_time_set_search / num_trials_search;
-		double average_time_vector_search = total_time_vector_search / num_trials_search;
+// ConcurrentSet against a mutex-wrapped Set for several thread counts and read ratios
+void benchmark_concurrent()
+{
+	const int key_range = 1 << 20;
+	const int read_percents[] = { 100, 99, 90, 50 };
+	int max_threads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
 
-		cout << "Average search time for Set with size " << size << ": " << average_time_set_search << " ms" << endl;
-		cout << "Average search time for vector with size " << size << ": " << average_time_vector_search << " ms" << endl;
+	ConcurrentSet concurrent;
+	LockedSet locked;
+	for (int key = 0; key < key_range; key += 2) {
+		concurrent.insert(key);
+		locked.insert(key);
+	}
 
-		// Insertion and deletion
-		for (int i = 0; i < num_trials_search; ++i) {
-			int random_number_insert = lcg();
-			int random_number_erase = lcg();
+	for (int read_percent : read_percents) {
+		for (int threads = 1; threads <= max_threads; threads *= 2) {
+			double concurrent_ops = measure_throughput(concurrent, threads, read_percent, key_range, 200.0);
+			double locked_ops = measure_throughput(locked, threads, read_percent, key_range, 200.0);
+			cout << "threads " << threads << " reads " << read_percent << "%: ConcurrentSet "
+				<< concurrent_ops / 1e6 << " Mops/s, locked Set " << locked_ops / 1e6 << " Mops/s" << endl;
+		}
+	}
+}
 
-			// Insertion in Set
-			auto set_insert_time = measure_execution_time([&]() {
-				my_set.insert(random_number_insert);
-				});
-			total_time_set_insert += set_insert_time;
 
-			// Deletion in Set
-			auto set_erase_time = measure_execution_time([&]() {
-				my_set.erase(random_number_erase);
-				});
-			total_time_set_erase += set_erase_time;
+void run_benchmark_suite(const std::vector<size_t>& sizes, const std::string& csv_path, const std::string& json_path)
+{
+	BenchmarkSuite suite;
+	const char* distributions[] = { "uniform", "sequential", "clustered" };
+	for (size_t size : sizes)
+	{
+		for (const char* distribution : distributions)
+		{
+			Workload w = make_workload(distribution, size, 42 + size);
+			bench_structure<Set>(suite, "Set", w);
+			bench_structure<std::set<int>>(suite, "std::set", w);
+			bench_structure<std::unordered_set<int>>(suite, "std::unordered_set", w);
+			if (std::string(distribution) != "uniform") {
+				// uniform keys cover the full 32-bit range, outside the bounded domain RoaringSet is for
+				bench_structure<RoaringSet>(suite, "RoaringSet", w);
+			}
 
-			// Insertion in vector
-			auto vector_insert_time = measure_execution_time([&]() {
-				my_vector.push_back(random_number_insert);
-				});
-			total_time_vector_insert += vector_insert_time;
+			FlatSet flat(w.keys);
+			bench_lookups(suite, "FlatSet", flat, w, 1000);
 
-			// Deletion in vector
-			auto vector_erase_time = measure_execution_time([&]() {
-				my_vector.erase(std::remove(my_vector.begin(), my_vector.end(), random_number_erase), my_vector.end());
-				});
-			total_time_vector_erase += vector_erase_time;
+			if (size <= 100000)
+			{
+				std::vector<int> vec(w.keys);
+				bench_lookups(suite, "std::vector", vec, w, size <= 10000 ? 256 : 16);
+			}
 		}
+	}
+	if (!csv_path.empty()) suite.write_csv(csv_path);
+	if (!json_path.empty()) suite.write_json(json_path);
+}
+
+
+// usage: lab1 [--sizes 1000,10000] [--csv file] [--json file] [--compare] [--concurrent]
+// --compare also runs the BST / arena / bulk build / snapshot / bitmap / warm start comparisons,
+// --concurrent the multi-threaded ConcurrentSet throughput runs
+int main(int argc, char* argv[]) {
+	std::vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+	std::string csv_path = "lab1_bench.csv";
+	std::string json_path = "lab1_bench.json";
+	bool compare = false;
+	bool concurrent = false;
 
-		double average_time_set_insert = total_time_set_insert / num_trials_search;
-		double average_time_set_erase = total_time_set_erase / num_trials_search;
-		double average_time_vector_insert = total_time_vector_insert / num_trials_search;
-		double average_time_vector_erase = total_time_vector_erase / num_trials_search;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--sizes" && i + 1 < argc) {
+			sizes.clear();
+			std::stringstream list(argv[++i]);
+			std::string item;
+			while (std::getline(list, item, ',')) sizes.push_back(std::stoul(item));
+		}
+		else if (arg == "--csv" && i + 1 < argc) csv_path = argv[++i];
+		else if (arg == "--json" && i + 1 < argc) json_path = argv[++i];
+		else if (arg == "--compare") compare = true;
+		else if (arg == "--concurrent") concurrent = true;
+	}
 
-		cout << "Average insert time for Set with size " << size << ": " << average_time_set_insert << " ms" << endl;
-		cout << "Average erase time for Set with size " << size << ": " << average_time_set_erase << " ms" << endl;
-		cout << "Average insert time for vector with size " << size << ": " << average_time_vector_insert << " ms" << endl;
-		cout << "Average erase time for vector with size " << size << ": " << average_time_vector_erase << " ms" << endl;
+	if (compare) {
+		benchmark_balanced();
+		benchmark_allocation();
+		benchmark_bulk_build();
+		benchmark_snapshots();
+		benchmark_bitmap();
+		benchmark_snapshot_file();
 	}
+	if (concurrent) {
+		benchmark_concurrent();
+	}
+	run_benchmark_suite(sizes, csv_path, json_path);
 
 	Set set1 = { 1, 2, 3, 4, 5 };
 	Set set2 = { 4, 5, 6, 7, 8 };
 
 	Set intersection_result = intersection(set1, set2);
 	Set difference_result = difference(set1, set2);
+	Set union_result = set_union(set1, set2);
 
 	intersection_result.print();
 	cout << endl;
 	difference_result.print();
+	cout << endl;
+	union_result.print();
+	cout << endl;
+	cout << "{1} == {1, 2}: " << (Set{ 1 } == Set{ 1, 2 });
 	
 	cout << endl;
 	Set set3 = { 1, 2, 3, 4 ,5 };
 	set3.erase(1);
 	set3.print();
+	cout << endl;
+
+	cout << "select(1): " << set3.select(1) << ", rank(4): " << set3.rank(4)
+		<< ", count_range(3, 10): " << set3.count_range(3, 10) << ", lower_bound(0): " << *set3.lower_bound(0) << endl;
+	for (auto it = set3.end(); it != set3.begin();) {
+		cout << *--it << " ";
+	}
 
 	return 0;
 }
\ No newline at end of file